@@ -0,0 +1,1293 @@
+/**
+* a B+ tree with the interface of sjtu::map
+*/
+#ifndef SJTU_BTREE_HPP
+#define SJTU_BTREE_HPP
+
+#include <functional>
+#include <cstddef>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include "utility.hpp"
+#include "exceptions.hpp"
+#include "pool.hpp"
+
+namespace sjtu {
+
+	/**
+	* where a key falls among the n sorted keys of a node.
+	* lower() counts the keys less than key, upper() the keys not greater.
+	* arithmetic keys under std::less are counted by a branch-free scan of the
+	*   whole array, which the compiler turns into SIMD compares; any other key
+	*   takes a binary search through Compare.
+	*/
+	template<class Key, class Compare, bool Scan = std::is_arithmetic<Key>::value && std::is_same<Compare, std::less<Key> >::value>
+	class btree_search {
+	public:
+		static const bool scans = false;
+		template<class K>
+		static size_t lower(const Key *keys, size_t n, const K &key, const Compare &comp)
+		{
+			size_t lo = 0, hi = n;
+			while (lo < hi)
+			{
+				size_t mid = (lo + hi) / 2;
+				if (comp(keys[mid], key))
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			return lo;
+		}
+		template<class K>
+		static size_t upper(const Key *keys, size_t n, const K &key, const Compare &comp)
+		{
+			size_t lo = 0, hi = n;
+			while (lo < hi)
+			{
+				size_t mid = (lo + hi) / 2;
+				if (!comp(key, keys[mid]))
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			return lo;
+		}
+	};
+	template<class Key, class Compare>
+	class btree_search<Key, Compare, true> {
+	public:
+		static const bool scans = true;
+		static size_t lower(const Key *keys, size_t n, const Key &key, const Compare &)
+		{
+			size_t r = 0;
+			for (size_t i = 0; i < n; i++)
+				r += keys[i] < key;
+			return r;
+		}
+		static size_t upper(const Key *keys, size_t n, const Key &key, const Compare &)
+		{
+			size_t r = 0;
+			for (size_t i = 0; i < n; i++)
+				r += !(key < keys[i]);
+			return r;
+		}
+	};
+
+	/**
+	* an ordered map kept in a B+ tree: every element sits in a leaf, the
+	*   leaves are chained in key order and the inner nodes only hold
+	*   separator keys. a node keeps its keys in one array, so a lookup
+	*   touches a few cache lines per level over about log_64(n) levels
+	*   instead of one line per level over log_2(n).
+	* the interface follows sjtu::map, with one difference: an insert or an
+	*   erase moves elements between nodes, so it invalidates every iterator
+	*   and reference into the map.
+	* an insert that throws leaves the map as it was. the elements it moves
+	*   aside are moved back, which cannot fail for keys and values with a
+	*   non-throwing move; a type that can only be copied must not throw on
+	*   the way back.
+	*/
+	template<
+		class Key,
+		class T,
+		class Compare = std::less<Key>
+	> class btree_map {
+	public:
+		typedef pair<const Key, T> value_type;
+	private:
+		// keys per node, about four cache lines of them
+		static const size_t SLOTS = 256 / sizeof(Key) < 8 ? 8 : 256 / sizeof(Key);
+		// a node other than the root with fewer keys borrows from or merges with a sibling
+		static const size_t MIN_SLOTS = SLOTS / 3;
+		static const int MAX_DEPTH = 64;
+		typedef btree_search<Key, Compare> search;
+		// leaves keep a key array of their own only for the scan, which needs the keys packed
+		static const bool LEAF_KEYS = search::scans;
+
+		class Node {
+		public:
+			bool isLeaf;
+			size_t count;
+		};
+		/**
+		* with LEAF_KEYS, keys()[i] is a copy of values()[i].first kept for
+		*   the scan; otherwise keyStore is a placeholder and the search goes
+		*   through values()[i].first, so a key is stored once.
+		*/
+		class Leaf : public Node {
+		public:
+			Leaf *prev, *next;
+			typename std::aligned_storage<LEAF_KEYS ? sizeof(Key) * SLOTS : 1, alignof(Key)>::type keyStore;
+			typename std::aligned_storage<sizeof(value_type) * SLOTS, alignof(value_type)>::type valueStore;
+			Key * keys() {
+				return reinterpret_cast<Key*>(&keyStore);
+			}
+			const Key * keys() const {
+				return reinterpret_cast<const Key*>(&keyStore);
+			}
+			value_type * values() {
+				return reinterpret_cast<value_type*>(&valueStore);
+			}
+			const value_type * values() const {
+				return reinterpret_cast<const value_type*>(&valueStore);
+			}
+			const Key & key(size_t i) const {
+				return values()[i].first;
+			}
+		};
+		// every key in child[i + 1] is not less than keys()[i], every key in child[i] is less
+		class Inner : public Node {
+		public:
+			typename std::aligned_storage<sizeof(Key) * SLOTS, alignof(Key)>::type keyStore;
+			Node *child[SLOTS + 1];
+			Key * keys() {
+				return reinterpret_cast<Key*>(&keyStore);
+			}
+			const Key * keys() const {
+				return reinterpret_cast<const Key*>(&keyStore);
+			}
+		};
+	public:
+		class const_iterator;
+		class iterator {
+		public:
+			btree_map *tree;
+			Leaf *lf;
+			size_t idx;
+		public:
+			iterator() {
+				tree = NULL;
+				lf = NULL;
+				idx = 0;
+			}
+			iterator(const iterator &other) {
+				tree = other.tree;
+				lf = other.lf;
+				idx = other.idx;
+			}
+			iterator(btree_map *tree, Leaf *lf, size_t idx) {
+				this->tree = tree;
+				this->lf = lf;
+				this->idx = idx;
+			}
+			iterator operator++(int)
+			{
+				iterator tmp(*this);
+				++*this;
+				return tmp;
+			}
+			iterator & operator++()
+			{
+				if (lf == NULL)
+					throw index_out_of_bound();
+				if (++idx == lf->count)
+				{
+					lf = lf->next;
+					idx = 0;
+				}
+				return *this;
+			}
+			iterator operator--(int)
+			{
+				iterator tmp(*this);
+				--*this;
+				return tmp;
+			}
+			iterator & operator--()
+			{
+				if (tree == NULL)
+					throw index_out_of_bound();
+				Leaf *p = lf == NULL ? tree->tail : lf;
+				size_t i = lf == NULL && p != NULL ? p->count : idx;
+				if (p != NULL && i == 0)
+				{
+					p = p->prev;
+					i = p == NULL ? 0 : p->count;
+				}
+				if (p == NULL)
+					throw index_out_of_bound();
+				lf = p;
+				idx = i - 1;
+				return *this;
+			}
+			value_type & operator*() const
+			{
+				return lf->values()[idx];
+			}
+			value_type* operator->() const noexcept {
+				return lf->values() + idx;
+			}
+			bool operator==(const iterator &rhs) const
+			{
+				return tree == rhs.tree && lf == rhs.lf && idx == rhs.idx;
+			}
+			bool operator==(const const_iterator &rhs) const
+			{
+				return tree == rhs.tree && lf == rhs.lf && idx == rhs.idx;
+			}
+			bool operator!=(const iterator &rhs) const
+			{
+				return !(*this == rhs);
+			}
+			bool operator!=(const const_iterator &rhs) const
+			{
+				return !(*this == rhs);
+			}
+			iterator& operator=(const iterator &rhs) {
+				tree = rhs.tree;
+				lf = rhs.lf;
+				idx = rhs.idx;
+				return *this;
+			}
+		};
+		class const_iterator {
+		public:
+			const btree_map *tree;
+			const Leaf *lf;
+			size_t idx;
+		public:
+			const_iterator() {
+				tree = NULL;
+				lf = NULL;
+				idx = 0;
+			}
+			const_iterator(const btree_map *tree, const Leaf *lf, size_t idx) {
+				this->tree = tree;
+				this->lf = lf;
+				this->idx = idx;
+			}
+			const_iterator(const const_iterator &other) {
+				tree = other.tree;
+				lf = other.lf;
+				idx = other.idx;
+			}
+			const_iterator(const iterator &other) {
+				tree = other.tree;
+				lf = other.lf;
+				idx = other.idx;
+			}
+			const_iterator& operator=(const const_iterator &other) {
+				tree = other.tree;
+				lf = other.lf;
+				idx = other.idx;
+				return *this;
+			}
+			bool operator==(const const_iterator &other) const {
+				return tree == other.tree && lf == other.lf && idx == other.idx;
+			}
+			bool operator!=(const const_iterator &other) const {
+				return !(*this == other);
+			}
+			const value_type* operator->() const {
+				return lf->values() + idx;
+			}
+			const value_type & operator*() const
+			{
+				return lf->values()[idx];
+			}
+			const_iterator operator++(int)
+			{
+				const_iterator tmp(*this);
+				++*this;
+				return tmp;
+			}
+			const_iterator & operator++()
+			{
+				if (lf == NULL)
+					throw index_out_of_bound();
+				if (++idx == lf->count)
+				{
+					lf = lf->next;
+					idx = 0;
+				}
+				return *this;
+			}
+			const_iterator operator--(int)
+			{
+				const_iterator tmp(*this);
+				--*this;
+				return tmp;
+			}
+			const_iterator & operator--()
+			{
+				if (tree == NULL)
+					throw index_out_of_bound();
+				const Leaf *p = lf == NULL ? tree->tail : lf;
+				size_t i = lf == NULL && p != NULL ? p->count : idx;
+				if (p != NULL && i == 0)
+				{
+					p = p->prev;
+					i = p == NULL ? 0 : p->count;
+				}
+				if (p == NULL)
+					throw index_out_of_bound();
+				lf = p;
+				idx = i - 1;
+				return *this;
+			}
+		};
+
+		btree_map() : root(NULL), head(NULL), tail(NULL), _size(0) {}
+		/**
+		* the elements are appended one by one in key order, which keeps every
+		*   leaf but the last full.
+		*/
+		btree_map(const btree_map &other) : root(NULL), head(NULL), tail(NULL), _size(0), comp(other.comp) {
+			copyFrom(other);
+		}
+		// other is left empty
+		btree_map(btree_map &&other) : root(NULL), head(NULL), tail(NULL), _size(0) {
+			take(other);
+		}
+		btree_map & operator=(const btree_map &other) {
+			if (this != &other)
+			{
+				clear();
+				comp = other.comp;
+				copyFrom(other);
+			}
+			return *this;
+		}
+		btree_map & operator=(btree_map &&other) {
+			if (this != &other)
+			{
+				clear();
+				take(other);
+			}
+			return *this;
+		}
+		~btree_map() {
+			clear();
+		}
+		/**
+		* access specified element with bounds checking
+		* Returns a reference to the mapped value of the element with key equivalent to key.
+		* If no such element exists, an exception of type `index_out_of_bound'
+		*/
+		T & at(const Key &key)
+		{
+			iterator it = find(key);
+			if (it.lf == NULL)
+				throw index_out_of_bound();
+			return it->second;
+		}
+		const T & at(const Key &key) const
+		{
+			const_iterator it = find(key);
+			if (it.lf == NULL)
+				throw index_out_of_bound();
+			return it->second;
+		}
+		/**
+		* with a transparent Compare (one that defines is_transparent, like
+		*   std::less<>) at, count, find, lower_bound, upper_bound and erase
+		*   also take any key type Compare can compare with Key, so no Key is
+		*   built to look up.
+		*/
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		T & at(const K &key)
+		{
+			iterator it = find(key);
+			if (it.lf == NULL)
+				throw index_out_of_bound();
+			return it->second;
+		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		const T & at(const K &key) const
+		{
+			const_iterator it = find(key);
+			if (it.lf == NULL)
+				throw index_out_of_bound();
+			return it->second;
+		}
+		/**
+		* access specified element
+		* Returns a reference to the value that is mapped to a key equivalent to key,
+		*   performing an insertion if such key does not already exist.
+		*/
+		T & operator[](const Key &key)
+		{
+			return emplaceUnique(key, key, T()).first->second;
+		}
+		/**
+		* behave like at() throw index_out_of_bound if such key does not exist.
+		*/
+		const T & operator[](const Key &key) const
+		{
+			return at(key);
+		}
+		iterator begin() {
+			return iterator(this, head, 0);
+		}
+		const_iterator begin() const {
+			return const_iterator(this, head, 0);
+		}
+		const_iterator cbegin() const {
+			return const_iterator(this, head, 0);
+		}
+		iterator end() {
+			return iterator(this, NULL, 0);
+		}
+		const_iterator end() const {
+			return const_iterator(this, NULL, 0);
+		}
+		const_iterator cend() const {
+			return const_iterator(this, NULL, 0);
+		}
+		bool empty() const {
+			return _size == 0;
+		}
+		size_t size() const {
+			return _size;
+		}
+		/**
+		* clears the contents, giving every node back at once
+		*/
+		void clear()
+		{
+			if (root != NULL && (!std::is_trivially_destructible<Key>::value || !std::is_trivially_destructible<value_type>::value))
+				destroy(root);
+			leafPool.release();
+			innerPool.release();
+			root = NULL;
+			head = tail = NULL;
+			_size = 0;
+		}
+		/**
+		* insert an element.
+		* return a pair, the first of the pair is
+		*   the iterator to the new element (or the element that prevented the insertion),
+		*   the second one is true if insert successfully, or false.
+		*/
+		pair<iterator, bool> insert(const value_type &value) {
+			return emplaceUnique(value.first, value);
+		}
+		pair<iterator, bool> insert(value_type &&value) {
+			return emplaceUnique(value.first, std::move(value));
+		}
+		/**
+		* insert value as close as possible to the position just before hint.
+		* when the key falls inside the leaf of hint (the last leaf for end())
+		*   and that leaf has room, the value goes straight in without a
+		*   descent from the root, so sorted input fed with end() or the
+		*   previous result as hint only searches one leaf per element.
+		* return an iterator to the new element or to the one that prevented the insertion.
+		*/
+		iterator insert(const_iterator hint, const value_type &value) {
+			return emplaceHinted(hint, value.first, value);
+		}
+		iterator insert(const_iterator hint, value_type &&value) {
+			return emplaceHinted(hint, value.first, std::move(value));
+		}
+		template<class... Args>
+		iterator emplace_hint(const_iterator hint, Args&&... args) {
+			value_type value(std::forward<Args>(args)...);
+			return emplaceHinted(hint, value.first, std::move(value));
+		}
+		/**
+		* insert a value built from args.
+		* its slot depends on the key, so the value is built aside first and
+		*   moved into the leaf; it is dropped again if the key already exists.
+		* return value is the same as insert().
+		*/
+		template<class... Args>
+		pair<iterator, bool> emplace(Args&&... args) {
+			value_type value(std::forward<Args>(args)...);
+			return emplaceUnique(value.first, std::move(value));
+		}
+		/**
+		* insert key with a value built from args in its slot, if key is not
+		*   present yet. nothing is constructed when key already exists.
+		* return value is the same as insert().
+		*/
+		template<class... Args>
+		pair<iterator, bool> try_emplace(const Key &key, Args&&... args) {
+			return emplaceUnique(key, std::piecewise_construct,
+				std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+		}
+		/**
+		* insert (key, obj), or assign obj to the element that already has key.
+		* the second of the returned pair is true if a new element was inserted.
+		*/
+		template<class M>
+		pair<iterator, bool> insert_or_assign(const Key &key, M &&obj) {
+			pair<iterator, bool> res = emplaceUnique(key, key, std::forward<M>(obj));
+			// obj is only consumed when the element is new
+			if (!res.second)
+				res.first->second = std::forward<M>(obj);
+			return res;
+		}
+		/**
+		* erase the element at pos.
+		* pos names its leaf and slot, so the element is removed in place; the
+		*   path from the root is only walked when the leaf falls below
+		*   MIN_SLOTS and has to borrow from or merge with a sibling.
+		* returns an iterator to the element after the erased one (or end()).
+		*
+		* throw if pos pointed to a bad element (pos == this->end() || pos points an element out of this)
+		*/
+		iterator erase(iterator pos)
+		{
+			if (pos.tree != this)
+				throw invalid_iterator();
+			if (pos.lf == NULL)
+				throw index_out_of_bound();
+			if (pos.idx >= pos.lf->count)
+				throw invalid_iterator();
+			if (pos.lf == root || pos.lf->count > MIN_SLOTS)
+				return eraseAt(NULL, NULL, 0, pos.lf, pos.idx);
+			Inner *path[MAX_DEPTH];
+			size_t slot[MAX_DEPTH];
+			int depth = 0;
+			if (descend(pos.lf->key(pos.idx), path, slot, depth) != pos.lf)
+				throw invalid_iterator();
+			return eraseAt(path, slot, depth, pos.lf, pos.idx);
+		}
+		/**
+		* erase the element with key, if any.
+		* returns the number of elements removed (0 or 1).
+		*/
+		size_t erase(const Key &key)
+		{
+			return eraseKey(key);
+		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		size_t erase(const K &key)
+		{
+			return eraseKey(key);
+		}
+		/**
+		* Returns the number of elements with key
+		*   that compares equivalent to the specified argument,
+		*   which is either 1 or 0
+		*/
+		size_t count(const Key &key) const
+		{
+			return findKey(key).lf == NULL ? 0 : 1;
+		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		size_t count(const K &key) const
+		{
+			return findKey(key).lf == NULL ? 0 : 1;
+		}
+		/**
+		* Finds an element with key equivalent to key.
+		* key value of the element to search for.
+		* Iterator to an element with key equivalent to key.
+		*   If no such element is found, past-the-end (see end()) iterator is returned.
+		*/
+		iterator find(const Key &key)
+		{
+			return unconst(findKey(key));
+		}
+		const_iterator find(const Key &key) const
+		{
+			return findKey(key);
+		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		iterator find(const K &key)
+		{
+			return unconst(findKey(key));
+		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		const_iterator find(const K &key) const
+		{
+			return findKey(key);
+		}
+		/**
+		* the first element whose key is not less than key, end() if none.
+		*/
+		iterator lower_bound(const Key &key)
+		{
+			return unconst(lowerBound(key));
+		}
+		const_iterator lower_bound(const Key &key) const
+		{
+			return lowerBound(key);
+		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		iterator lower_bound(const K &key)
+		{
+			return unconst(lowerBound(key));
+		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		const_iterator lower_bound(const K &key) const
+		{
+			return lowerBound(key);
+		}
+		/**
+		* the first element whose key is greater than key, end() if none.
+		*/
+		iterator upper_bound(const Key &key)
+		{
+			return unconst(upperBound(key));
+		}
+		const_iterator upper_bound(const Key &key) const
+		{
+			return upperBound(key);
+		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		iterator upper_bound(const K &key)
+		{
+			return unconst(upperBound(key));
+		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		const_iterator upper_bound(const K &key) const
+		{
+			return upperBound(key);
+		}
+		/**
+		* the elements with key equivalent to key: [lower_bound, upper_bound).
+		*/
+		pair<iterator, iterator> equal_range(const Key &key)
+		{
+			iterator it = lower_bound(key), next = it;
+			if (it.lf != NULL && !comp(key, it->first))
+				++next;
+			return pair<iterator, iterator>(it, next);
+		}
+		pair<const_iterator, const_iterator> equal_range(const Key &key) const
+		{
+			const_iterator it = lower_bound(key), next = it;
+			if (it.lf != NULL && !comp(key, it->first))
+				++next;
+			return pair<const_iterator, const_iterator>(it, next);
+		}
+		/**
+		* bytes taken by a leaf and by an inner node, and keys held by each.
+		*/
+		static size_t leaf_bytes()
+		{
+			return slab_pool<sizeof(Leaf), alignof(Leaf)>::block_size();
+		}
+		static size_t inner_bytes()
+		{
+			return slab_pool<sizeof(Inner), alignof(Inner)>::block_size();
+		}
+		static size_t node_slots()
+		{
+			return SLOTS;
+		}
+	private:
+		// slot idx of lf, stepping into the next leaf when it is one past the last
+		const_iterator position(const Leaf *lf, size_t idx) const
+		{
+			if (idx == lf->count)
+			{
+				lf = lf->next;
+				idx = 0;
+			}
+			return const_iterator(this, lf, idx);
+		}
+		iterator unconst(const_iterator it)
+		{
+			return iterator(this, const_cast<Leaf*>(it.lf), it.idx);
+		}
+		template<class K>
+		const_iterator findKey(const K &key) const
+		{
+			const_iterator it = lowerBound(key);
+			if (it.lf == NULL || comp(key, it->first))
+				return end();
+			return it;
+		}
+		template<class K>
+		const_iterator lowerBound(const K &key) const
+		{
+			const Leaf *lf = findLeaf(key);
+			if (lf == NULL)
+				return end();
+			return position(lf, leafLower(lf, key));
+		}
+		template<class K>
+		const_iterator upperBound(const K &key) const
+		{
+			const Leaf *lf = findLeaf(key);
+			if (lf == NULL)
+				return end();
+			return position(lf, leafUpper(lf, key));
+		}
+		// the only leaf that may hold key, NULL if the map is empty
+		template<class K>
+		const Leaf * findLeaf(const K &key) const
+		{
+			const Node *n = root;
+			if (n == NULL)
+				return NULL;
+			while (!n->isLeaf)
+			{
+				const Inner *in = static_cast<const Inner*>(n);
+				n = in->child[search::upper(in->keys(), in->count, key, comp)];
+			}
+			return static_cast<const Leaf*>(n);
+		}
+		/**
+		* insert value_type(args...) under key unless key is already there.
+		* the descent records its path, a full leaf is split and the new
+		*   separator goes up that path, splitting full inner nodes on its way.
+		*/
+		template<class... Args>
+		pair<iterator, bool> emplaceUnique(const Key &key, Args&&... args)
+		{
+			if (root == NULL)
+			{
+				root = head = tail = newLeaf();
+			}
+			Inner *path[MAX_DEPTH];
+			size_t slot[MAX_DEPTH];
+			int depth = 0;
+			Leaf *lf = descend(key, path, slot, depth);
+			size_t i = leafLower(lf, key);
+			if (i < lf->count && !comp(key, lf->key(i)))
+				return pair<iterator, bool>(iterator(this, lf, i), false);
+			if (lf->count == SLOTS)
+			{
+				// appending to the last leaf leaves it full, ascending keys fill every leaf
+				size_t keep = lf == tail && i == lf->count ? lf->count - 1 : lf->count / 2;
+				Leaf *r = splitLeaf(lf, keep);
+				try {
+					insertSeparator(path, slot, depth, r->key(0), r);
+				}
+				catch (...) {
+					mergeLeaves(lf, r);
+					throw;
+				}
+				if (i > keep)
+				{
+					i -= keep;
+					lf = r;
+				}
+			}
+			try {
+				leafInsert(lf, i, std::forward<Args>(args)...);
+			}
+			catch (...) {
+				// a leaf split on the way stays, the tree is whole either way
+				if (_size == 0)
+				{
+					freeLeaf(lf);
+					root = head = tail = NULL;
+				}
+				throw;
+			}
+			_size++;
+			return pair<iterator, bool>(iterator(this, lf, i), true);
+		}
+		/**
+		* emplaceUnique, but starting at the leaf of hint (the last leaf for
+		*   end()) when key surely belongs there and the leaf has room: inside
+		*   its key range, or beyond it on the side of the first or last leaf.
+		*/
+		template<class... Args>
+		iterator emplaceHinted(const_iterator hint, const Key &key, Args&&... args)
+		{
+			Leaf *lf = hint.tree != this ? NULL : hint.lf == NULL ? tail : const_cast<Leaf*>(hint.lf);
+			if (lf == NULL || lf->count == SLOTS
+				|| (lf != head && comp(key, lf->key(0)))
+				|| (lf != tail && comp(lf->key(lf->count - 1), key)))
+				return emplaceUnique(key, std::forward<Args>(args)...).first;
+			size_t i = leafLower(lf, key);
+			if (i < lf->count && !comp(key, lf->key(i)))
+				return iterator(this, lf, i);
+			leafInsert(lf, i, std::forward<Args>(args)...);
+			_size++;
+			return iterator(this, lf, i);
+		}
+		// walk from the root to the leaf for key, recording the inner nodes and child slots taken
+		template<class K>
+		Leaf * descend(const K &key, Inner **path, size_t *slot, int &depth)
+		{
+			Node *n = root;
+			while (!n->isLeaf)
+			{
+				Inner *in = static_cast<Inner*>(n);
+				size_t i = search::upper(in->keys(), in->count, key, comp);
+				path[depth] = in;
+				slot[depth++] = i;
+				n = in->child[i];
+			}
+			return static_cast<Leaf*>(n);
+		}
+		template<class K>
+		size_t eraseKey(const K &key)
+		{
+			if (root == NULL)
+				return 0;
+			Inner *path[MAX_DEPTH];
+			size_t slot[MAX_DEPTH];
+			int depth = 0;
+			Leaf *lf = descend(key, path, slot, depth);
+			size_t i = leafLower(lf, key);
+			if (i == lf->count || comp(key, lf->key(i)))
+				return 0;
+			eraseAt(path, slot, depth, lf, i);
+			return 1;
+		}
+		/**
+		* remove slot i of lf, then refill or merge the nodes on path (the
+		*   depth inner nodes above lf) that fell below MIN_SLOTS, bottom-up.
+		*/
+		/**
+		* erase slot i of lf and rebalance up the recorded path.
+		* returns the position of the element that followed it, which a leaf
+		*   merge or borrow may have moved to the neighbouring leaf.
+		*/
+		iterator eraseAt(Inner **path, size_t *slot, int depth, Leaf *lf, size_t i)
+		{
+			Node *n = lf;
+			lf->values()[i].~value_type();
+			moveSlots(lf, i, lf, i + 1, lf->count - i - 1);
+			lf->count--;
+			_size--;
+			Leaf *next = i < lf->count ? lf : lf->next;
+			size_t at = i < lf->count ? i : 0;
+
+			while (depth > 0 && n->count < MIN_SLOTS)
+			{
+				Inner *parent = path[--depth];
+				size_t j = slot[depth] > 0 ? slot[depth] - 1 : 0;
+				if (n->isLeaf)
+				{
+					Leaf *a = static_cast<Leaf*>(parent->child[j]);
+					Leaf *b = static_cast<Leaf*>(parent->child[j + 1]);
+					// where next falls in a and b taken as one run
+					bool moves = next == a || next == b;
+					size_t run = next == b ? a->count + at : at;
+					if (a->count + b->count <= SLOTS)
+					{
+						mergeLeaves(a, b);
+						removeSeparator(parent, j);
+						if (moves)
+						{
+							next = a;
+							at = run;
+						}
+					}
+					else
+					{
+						balanceLeaves(a, b);
+						if (moves)
+						{
+							next = run < a->count ? a : b;
+							at = run < a->count ? run : run - a->count;
+						}
+						parent->keys()[j].~Key();
+						new (parent->keys() + j) Key(b->key(0));
+					}
+				}
+				else
+				{
+					Inner *a = static_cast<Inner*>(parent->child[j]);
+					Inner *b = static_cast<Inner*>(parent->child[j + 1]);
+					if (a->count + b->count + 1 <= SLOTS)
+					{
+						mergeInners(a, b, parent->keys()[j]);
+						removeSeparator(parent, j);
+					}
+					else
+						balanceInners(a, b, parent->keys()[j]);
+				}
+				n = parent;
+			}
+			if (root->count == 0)
+			{
+				if (root->isLeaf)
+				{
+					freeLeaf(static_cast<Leaf*>(root));
+					root = head = tail = NULL;
+				}
+				else
+				{
+					Inner *in = static_cast<Inner*>(root);
+					root = in->child[0];
+					freeInner(in);
+				}
+			}
+			return iterator(this, next, at);
+		}
+
+		/**
+		* move the n elements at src into the raw slots at dst, leaving src
+		*   raw; the ranges may overlap.
+		* an element is moved only if that cannot throw (move_if_noexcept),
+		*   otherwise copied, so it stays whole until the copy exists. if a
+		*   copy throws, the elements already moved go back and the
+		*   exception passes on: both ranges are as they were.
+		*/
+		template<class V>
+		static void relocate(V *dst, V *src, size_t n)
+		{
+			// moving up, the last element goes first
+			bool up = std::less<V*>()(src, dst);
+			size_t done = 0;
+			try {
+				for (; done < n; done++)
+				{
+					size_t i = up ? n - 1 - done : done;
+					new (dst + i) V(std::move_if_noexcept(src[i]));
+					src[i].~V();
+				}
+			}
+			catch (...) {
+				while (done-- > 0)
+				{
+					size_t i = up ? n - 1 - done : done;
+					new (src + i) V(std::move_if_noexcept(dst[i]));
+					dst[i].~V();
+				}
+				throw;
+			}
+		}
+		// move a[from, count) by places to the right
+		template<class V>
+		static void shiftRight(V *a, size_t from, size_t count, size_t by)
+		{
+			relocate(a + from + by, a + from, count - from);
+		}
+		// move a[from, count) by places to the left
+		template<class V>
+		static void shiftLeft(V *a, size_t from, size_t count, size_t by)
+		{
+			relocate(a + from - by, a + from, count - from);
+		}
+
+		/**
+		* move the n elements of src from slot s on into the raw slots of dst
+		*   from d on, leaving theirs raw; src and dst may be the same leaf.
+		* all or nothing, like relocate(): the leaf keys under LEAF_KEYS are
+		*   arithmetic and move without throwing, so they need no destructor
+		*   and cannot fail after the values have moved.
+		*/
+		void moveSlots(Leaf *dst, size_t d, Leaf *src, size_t s, size_t n)
+		{
+			relocate(dst->values() + d, src->values() + s, n);
+			if (LEAF_KEYS)
+				relocate(dst->keys() + d, src->keys() + s, n);
+		}
+		// the number of keys in lf less than key, and not greater than key
+		template<class K>
+		size_t leafLower(const Leaf *lf, const K &key) const
+		{
+			if (LEAF_KEYS)
+				return search::lower(lf->keys(), lf->count, key, comp);
+			size_t lo = 0, hi = lf->count;
+			while (lo < hi)
+			{
+				size_t mid = (lo + hi) / 2;
+				if (comp(lf->key(mid), key))
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			return lo;
+		}
+		template<class K>
+		size_t leafUpper(const Leaf *lf, const K &key) const
+		{
+			if (LEAF_KEYS)
+				return search::upper(lf->keys(), lf->count, key, comp);
+			size_t lo = 0, hi = lf->count;
+			while (lo < hi)
+			{
+				size_t mid = (lo + hi) / 2;
+				if (!comp(key, lf->key(mid)))
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			return lo;
+		}
+
+		template<class... Args>
+		void leafInsert(Leaf *lf, size_t i, Args&&... args)
+		{
+			moveSlots(lf, i + 1, lf, i, lf->count - i);
+			try {
+				new (lf->values() + i) value_type(std::forward<Args>(args)...);
+			}
+			catch (...) {
+				moveSlots(lf, i, lf, i + 1, lf->count - i);
+				throw;
+			}
+			if (LEAF_KEYS)
+				new (lf->keys() + i) Key(lf->key(i));
+			lf->count++;
+		}
+		// lf keeps its first keep elements, a new leaf after it takes the rest
+		Leaf * splitLeaf(Leaf *lf, size_t keep)
+		{
+			Leaf *r = newLeaf();
+			try {
+				moveSlots(r, 0, lf, keep, lf->count - keep);
+			}
+			catch (...) {
+				leafPool.deallocate(r);
+				throw;
+			}
+			r->count = lf->count - keep;
+			lf->count = keep;
+			r->prev = lf;
+			r->next = lf->next;
+			if (lf->next != NULL)
+				lf->next->prev = r;
+			else
+				tail = r;
+			lf->next = r;
+			return r;
+		}
+		/**
+		* put separator sep with right child right into path[depth - 1] at
+		*   its recorded slot. a full node is split around its middle key,
+		*   which goes one level up in turn; a split root grows the tree.
+		* if a key copy or an allocation throws, every level undoes its own
+		*   part on the way out and the tree is as it was.
+		*/
+		void insertSeparator(Inner **path, size_t *slot, int depth, const Key &sep, Node *right)
+		{
+			if (depth == 0)
+			{
+				Inner *in = newInner();
+				try {
+					new (in->keys()) Key(sep);
+				}
+				catch (...) {
+					innerPool.deallocate(in);
+					throw;
+				}
+				in->child[0] = root;
+				in->child[1] = right;
+				in->count = 1;
+				root = in;
+				return;
+			}
+			Inner *in = path[depth - 1];
+			size_t i = slot[depth - 1];
+			if (in->count < SLOTS)
+			{
+				innerInsert(in, i, sep, right);
+				return;
+			}
+			size_t mid = SLOTS / 2;
+			Inner *r = newInner();
+			try {
+				relocate(r->keys(), in->keys() + mid + 1, in->count - mid - 1);
+			}
+			catch (...) {
+				innerPool.deallocate(r);
+				throw;
+			}
+			for (size_t x = mid + 1; x <= in->count; x++)
+				r->child[x - mid - 1] = in->child[x];
+			r->count = in->count - mid - 1;
+			in->count = mid;
+			Key *upSlot = in->keys() + mid;
+			Inner *to = i <= mid ? in : r;
+			size_t at = i <= mid ? i : i - mid - 1;
+			try {
+				Key up(std::move_if_noexcept(*upSlot));
+				upSlot->~Key();
+				try {
+					innerInsert(to, at, sep, right);
+					try {
+						insertSeparator(path, slot, depth - 1, up, r);
+					}
+					catch (...) {
+						removeSeparator(to, at);
+						throw;
+					}
+				}
+				catch (...) {
+					new (upSlot) Key(std::move_if_noexcept(up));
+					throw;
+				}
+			}
+			catch (...) {
+				// in still holds the middle key in its slot, take the rest back from r
+				relocate(in->keys() + mid + 1, r->keys(), r->count);
+				for (size_t x = 0; x <= r->count; x++)
+					in->child[mid + 1 + x] = r->child[x];
+				in->count = mid + 1 + r->count;
+				innerPool.deallocate(r);
+				throw;
+			}
+		}
+		void innerInsert(Inner *in, size_t i, const Key &sep, Node *right)
+		{
+			shiftRight(in->keys(), i, in->count, 1);
+			try {
+				new (in->keys() + i) Key(sep);
+			}
+			catch (...) {
+				shiftLeft(in->keys(), i + 1, in->count + 1, 1);
+				throw;
+			}
+			for (size_t c = in->count + 1; c > i + 1; c--)
+				in->child[c] = in->child[c - 1];
+			in->child[i + 1] = right;
+			in->count++;
+		}
+		// drop keys()[j] and child[j + 1]
+		void removeSeparator(Inner *in, size_t j)
+		{
+			in->keys()[j].~Key();
+			shiftLeft(in->keys(), j + 1, in->count, 1);
+			for (size_t c = j + 1; c < in->count; c++)
+				in->child[c] = in->child[c + 1];
+			in->count--;
+		}
+		// b is the leaf right after a, its elements move to the end of a
+		void mergeLeaves(Leaf *a, Leaf *b)
+		{
+			moveSlots(a, a->count, b, 0, b->count);
+			a->count += b->count;
+			b->count = 0;
+			a->next = b->next;
+			if (b->next != NULL)
+				b->next->prev = a;
+			else
+				tail = a;
+			freeLeaf(b);
+		}
+		// spread the elements of neighbouring leaves a and b evenly
+		void balanceLeaves(Leaf *a, Leaf *b)
+		{
+			size_t target = (a->count + b->count) / 2;
+			if (a->count < target)
+			{
+				size_t k = target - a->count;
+				moveSlots(a, a->count, b, 0, k);
+				moveSlots(b, 0, b, k, b->count - k);
+				a->count += k;
+				b->count -= k;
+			}
+			else
+			{
+				size_t k = a->count - target;
+				moveSlots(b, k, b, 0, b->count);
+				moveSlots(b, 0, a, target, k);
+				a->count -= k;
+				b->count += k;
+			}
+		}
+		// sep separates a and b in their parent and comes down between them
+		void mergeInners(Inner *a, Inner *b, const Key &sep)
+		{
+			new (a->keys() + a->count) Key(sep);
+			relocate(a->keys() + a->count + 1, b->keys(), b->count);
+			for (size_t i = 0; i <= b->count; i++)
+				a->child[a->count + 1 + i] = b->child[i];
+			a->count += b->count + 1;
+			b->count = 0;
+			freeInner(b);
+		}
+		// rotate keys through the separator sep until a and b hold about as many
+		void balanceInners(Inner *a, Inner *b, Key &sep)
+		{
+			size_t target = (a->count + b->count) / 2;
+			while (a->count < target)
+			{
+				relocate(a->keys() + a->count, &sep, 1);
+				a->child[a->count + 1] = b->child[0];
+				a->count++;
+				relocate(&sep, b->keys(), 1);
+				shiftLeft(b->keys(), 1, b->count, 1);
+				for (size_t c = 0; c < b->count; c++)
+					b->child[c] = b->child[c + 1];
+				b->count--;
+			}
+			while (a->count > target)
+			{
+				shiftRight(b->keys(), 0, b->count, 1);
+				for (size_t c = b->count + 1; c > 0; c--)
+					b->child[c] = b->child[c - 1];
+				relocate(b->keys(), &sep, 1);
+				b->child[0] = a->child[a->count];
+				b->count++;
+				relocate(&sep, a->keys() + a->count - 1, 1);
+				a->count--;
+			}
+		}
+
+		// move the nodes of other, with the slabs holding them, into this empty map
+		void take(btree_map &other)
+		{
+			leafPool.absorb(other.leafPool);
+			innerPool.absorb(other.innerPool);
+			root = other.root;
+			head = other.head;
+			tail = other.tail;
+			_size = other._size;
+			comp = other.comp;
+			other.root = NULL;
+			other.head = other.tail = NULL;
+			other._size = 0;
+		}
+		void copyFrom(const btree_map &other)
+		{
+			try {
+				for (const Leaf *lf = other.head; lf != NULL; lf = lf->next)
+					for (size_t i = 0; i < lf->count; i++)
+						emplaceUnique(lf->key(i), lf->values()[i]);
+			}
+			catch (...) {
+				clear();
+				throw;
+			}
+		}
+		Leaf * newLeaf()
+		{
+			Leaf *p = static_cast<Leaf*>(leafPool.allocate());
+			p->isLeaf = true;
+			p->count = 0;
+			p->prev = p->next = NULL;
+			return p;
+		}
+		Inner * newInner()
+		{
+			Inner *p = static_cast<Inner*>(innerPool.allocate());
+			p->isLeaf = false;
+			p->count = 0;
+			return p;
+		}
+		void freeLeaf(Leaf *p)
+		{
+			for (size_t i = 0; i < p->count; i++)
+				p->values()[i].~value_type();
+			leafPool.deallocate(p);
+		}
+		void freeInner(Inner *p)
+		{
+			for (size_t i = 0; i < p->count; i++)
+				p->keys()[i].~Key();
+			innerPool.deallocate(p);
+		}
+		// run the destructors of everything below n, the pools take the memory back
+		void destroy(Node *n)
+		{
+			if (n->isLeaf)
+			{
+				Leaf *lf = static_cast<Leaf*>(n);
+				for (size_t i = 0; i < lf->count; i++)
+					lf->values()[i].~value_type();
+				return;
+			}
+			Inner *in = static_cast<Inner*>(n);
+			for (size_t i = 0; i <= in->count; i++)
+				destroy(in->child[i]);
+			for (size_t i = 0; i < in->count; i++)
+				in->keys()[i].~Key();
+		}
+	private:
+		Node *root;
+		Leaf *head, *tail;
+		size_t _size;
+		Compare comp;
+		slab_pool<sizeof(Leaf), alignof(Leaf)> leafPool;
+		slab_pool<sizeof(Inner), alignof(Inner)> innerPool;
+	};
+
+}
+
+#endif
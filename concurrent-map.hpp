@@ -0,0 +1,441 @@
+/**
+* a map that many threads can use at once
+*/
+#ifndef SJTU_CONCURRENT_MAP_HPP
+#define SJTU_CONCURRENT_MAP_HPP
+
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <atomic>
+#include <thread>
+#include <utility>
+#ifdef SJTU_CONCURRENT_MAP_SHARED_MUTEX
+#include <shared_mutex>
+#endif
+#include "utility.hpp"
+#include "exceptions.hpp"
+#include "vector.hpp"
+#include "map.hpp"
+
+namespace sjtu {
+
+	/**
+	* a readers-writer spin lock in one word.
+	* the top bit marks a writer, the rest count readers. a writer takes the
+	*   bit first and then waits for the readers to drain, and new readers
+	*   wait while the bit is set, so a stream of readers cannot starve it.
+	* waiting threads yield, the lock is meant for short critical sections.
+	*/
+	class spin_rw_lock {
+	private:
+		static const unsigned WRITER = 1u << 31;
+	public:
+		spin_rw_lock() : state(0) {}
+		spin_rw_lock(const spin_rw_lock &other) = delete;
+		spin_rw_lock & operator=(const spin_rw_lock &other) = delete;
+		void lock()
+		{
+			unsigned s = state.load(std::memory_order_relaxed);
+			while ((s & WRITER) || !state.compare_exchange_weak(s, s | WRITER, std::memory_order_acquire, std::memory_order_relaxed))
+			{
+				std::this_thread::yield();
+				s = state.load(std::memory_order_relaxed);
+			}
+			while ((state.load(std::memory_order_acquire) & ~WRITER) != 0)
+				std::this_thread::yield();
+		}
+		void unlock()
+		{
+			state.fetch_and(~WRITER, std::memory_order_release);
+		}
+		void lock_shared()
+		{
+			for (;;)
+			{
+				while (state.load(std::memory_order_relaxed) & WRITER)
+					std::this_thread::yield();
+				if (!(state.fetch_add(1, std::memory_order_acquire) & WRITER))
+					return;
+				state.fetch_sub(1, std::memory_order_relaxed);
+			}
+		}
+		void unlock_shared()
+		{
+			state.fetch_sub(1, std::memory_order_release);
+		}
+	private:
+		std::atomic<unsigned> state;
+	};
+
+	/**
+	* the lock of a concurrent_map shard. it is spin_rw_lock unless
+	*   SJTU_CONCURRENT_MAP_SHARED_MUTEX is defined (C++17 and later), which
+	*   picks std::shared_mutex; define it for every translation unit or for
+	*   none, since the shard layout depends on it.
+	*/
+#ifdef SJTU_CONCURRENT_MAP_SHARED_MUTEX
+	typedef std::shared_mutex rw_lock;
+#else
+	typedef spin_rw_lock rw_lock;
+#endif
+
+	/**
+	* an ordered map split by key range into shards, each an sjtu::map behind
+	*   its own rw_lock. find, at and count take the shard's lock shared, so
+	*   readers of one shard run in parallel; writers only hold up their own
+	*   shard.
+	* the ranges are fixed at construction: shard i holds the keys in
+	*   [splits[i - 1], splits[i]). pick splits that spread the expected keys,
+	*   e.g. even_splits() for integers.
+	* no reference into the map is handed out, values are copied out under
+	*   the lock, and the iterator is a weakly consistent scan (see
+	*   const_iterator).
+	*/
+	template<
+		class Key,
+		class T,
+		class Compare = std::less<Key>
+	> class concurrent_map {
+	public:
+		typedef pair<const Key, T> value_type;
+	private:
+		// a cache line or more each, so the locks of neighbouring shards never share one
+		class alignas(64) shard {
+		public:
+			mutable rw_lock lock;
+			map<Key, T, Compare> m;
+		};
+		class read_guard {
+		public:
+			explicit read_guard(const shard &s) : s(s) {
+				s.lock.lock_shared();
+			}
+			~read_guard() {
+				s.lock.unlock_shared();
+			}
+		private:
+			const shard &s;
+		};
+		class write_guard {
+		public:
+			explicit write_guard(shard &s) : s(s) {
+				s.lock.lock();
+			}
+			~write_guard() {
+				s.lock.unlock();
+			}
+		private:
+			shard &s;
+		};
+		// elements the iterator copies out per visit to a shard
+		static const size_t BATCH = 256;
+	public:
+		/**
+		* an ordered walk over every shard.
+		* it copies up to BATCH elements at a time under a shared lock and
+		*   then lets go, so it never blocks a writer for long and cannot
+		*   deadlock with the thread that holds it. each batch is a
+		*   consistent slice of its shard; across batches it sees the keys in
+		*   order, each at most once, and may or may not see concurrent
+		*   changes.
+		*/
+		class const_iterator {
+		public:
+			const_iterator() : owner(NULL), sh(0), pos(0) {}
+			const_iterator(const const_iterator &other) = default;
+			const_iterator & operator=(const const_iterator &other) = default;
+			const value_type & operator*() const
+			{
+				return buf[pos];
+			}
+			const value_type* operator->() const
+			{
+				return &buf[pos];
+			}
+			const_iterator operator++(int)
+			{
+				const_iterator tmp(*this);
+				++*this;
+				return tmp;
+			}
+			const_iterator & operator++()
+			{
+				if (owner == NULL || sh == owner->nShards)
+					throw index_out_of_bound();
+				if (++pos == buf.size())
+					owner->refill(*this, &buf[pos - 1].first);
+				return *this;
+			}
+			/**
+			* two iterators are equal when both are past the end or both stand
+			*   on the same key of the same map.
+			*/
+			bool operator==(const const_iterator &rhs) const
+			{
+				if (owner != rhs.owner)
+					return false;
+				bool end = owner == NULL || sh == owner->nShards;
+				bool rhsEnd = rhs.owner == NULL || rhs.sh == rhs.owner->nShards;
+				if (end || rhsEnd)
+					return end == rhsEnd;
+				return !owner->comp(buf[pos].first, rhs.buf[rhs.pos].first) && !owner->comp(rhs.buf[rhs.pos].first, buf[pos].first);
+			}
+			bool operator!=(const const_iterator &rhs) const
+			{
+				return !(*this == rhs);
+			}
+		private:
+			friend class concurrent_map;
+			const concurrent_map *owner;
+			size_t sh;
+			size_t pos;
+			vector<value_type> buf;
+		};
+		typedef const_iterator iterator;
+
+		// a single shard, i.e. one lock
+		concurrent_map() : nShards(1) {
+			allocShards();
+		}
+		/**
+		* splits.size() + 1 shards, split at the keys of splits, which must be
+		*   sorted without duplicates; throw runtime_error if they are not.
+		*/
+		explicit concurrent_map(const vector<Key> &splits) : nShards(splits.size() + 1) {
+			for (size_t i = 1; i < splits.size(); i++)
+				if (!comp(splits[i - 1], splits[i]))
+					throw runtime_error();
+			allocShards();
+			for (size_t i = 0; i < splits.size(); i++)
+				bounds.push_back(splits[i]);
+		}
+		concurrent_map(const concurrent_map &other) = delete;
+		concurrent_map & operator=(const concurrent_map &other) = delete;
+		~concurrent_map() {
+			freeShards(nShards);
+		}
+		/**
+		* shards - 1 keys cutting [lo, hi) into shards ranges of equal width,
+		*   for integer keys spread evenly over it.
+		*/
+		static vector<Key> even_splits(const Key &lo, const Key &hi, size_t shards)
+		{
+			vector<Key> splits;
+			for (size_t i = 1; i < shards; i++)
+				splits.push_back(static_cast<Key>(lo + (hi - lo) / static_cast<Key>(shards) * static_cast<Key>(i)));
+			return splits;
+		}
+		/**
+		* a copy of the value mapped to key,
+		*   throw index_out_of_bound if there is none.
+		*/
+		T at(const Key &key) const
+		{
+			const shard &s = shards[shardOf(key)];
+			read_guard g(s);
+			return s.m.at(key);
+		}
+		/**
+		* copy the value mapped to key into value; false if there is none.
+		*/
+		bool find(const Key &key, T &value) const
+		{
+			const shard &s = shards[shardOf(key)];
+			read_guard g(s);
+			typename map<Key, T, Compare>::const_iterator it = s.m.find(key);
+			if (it == s.m.cend())
+				return false;
+			value = it->second;
+			return true;
+		}
+		size_t count(const Key &key) const
+		{
+			const shard &s = shards[shardOf(key)];
+			read_guard g(s);
+			return s.m.count(key);
+		}
+		/**
+		* insert value unless its key is there; true if it was inserted.
+		*/
+		bool insert(const value_type &value)
+		{
+			shard &s = shards[shardOf(value.first)];
+			write_guard g(s);
+			return s.m.insert(value).second;
+		}
+		/**
+		* map key to obj whether or not it was there; true if it was not.
+		*/
+		template<class M>
+		bool insert_or_assign(const Key &key, M &&obj)
+		{
+			shard &s = shards[shardOf(key)];
+			write_guard g(s);
+			return s.m.insert_or_assign(key, std::forward<M>(obj)).second;
+		}
+		/**
+		* run f on the value mapped to key while its shard is locked for
+		*   writing, for read-modify-write; false if there is no such key.
+		*/
+		template<class F>
+		bool update(const Key &key, F f)
+		{
+			shard &s = shards[shardOf(key)];
+			write_guard g(s);
+			typename map<Key, T, Compare>::iterator it = s.m.find(key);
+			if (it == s.m.end())
+				return false;
+			f(it->second);
+			return true;
+		}
+		size_t erase(const Key &key)
+		{
+			shard &s = shards[shardOf(key)];
+			write_guard g(s);
+			return s.m.erase(key);
+		}
+		/**
+		* the sum of the shard sizes, each read under its lock; with
+		*   concurrent writers it is not the size at any single moment.
+		*/
+		size_t size() const
+		{
+			size_t n = 0;
+			for (size_t i = 0; i < nShards; i++)
+			{
+				read_guard g(shards[i]);
+				n += shards[i].m.size();
+			}
+			return n;
+		}
+		bool empty() const
+		{
+			return size() == 0;
+		}
+		void clear()
+		{
+			for (size_t i = 0; i < nShards; i++)
+			{
+				write_guard g(shards[i]);
+				shards[i].m.clear();
+			}
+		}
+		size_t shard_count() const
+		{
+			return nShards;
+		}
+		const_iterator begin() const
+		{
+			return lower_bound(NULL, 0);
+		}
+		const_iterator cbegin() const
+		{
+			return begin();
+		}
+		const_iterator end() const
+		{
+			const_iterator it;
+			it.owner = this;
+			it.sh = nShards;
+			return it;
+		}
+		const_iterator cend() const
+		{
+			return end();
+		}
+		/**
+		* an ordered walk from the first key not less than key.
+		*/
+		const_iterator lower_bound(const Key &key) const
+		{
+			return lower_bound(&key, shardOf(key));
+		}
+	private:
+		/**
+		* new[] only honours alignas(64) from C++17 on, so the shards are
+		*   placed by hand in a block with room to align the first one.
+		*/
+		void allocShards()
+		{
+			store = ::operator new(sizeof(shard) * nShards + alignof(shard));
+			std::uintptr_t at = reinterpret_cast<std::uintptr_t>(store);
+			shards = reinterpret_cast<shard*>((at + alignof(shard) - 1) / alignof(shard) * alignof(shard));
+			size_t i = 0;
+			try {
+				for (; i < nShards; i++)
+					new (shards + i) shard();
+			}
+			catch (...) {
+				freeShards(i);
+				throw;
+			}
+		}
+		// destroy the first n shards and give the block back
+		void freeShards(size_t n)
+		{
+			for (size_t i = 0; i < n; i++)
+				shards[i].~shard();
+			::operator delete(store);
+		}
+		// the shard whose range holds key
+		size_t shardOf(const Key &key) const
+		{
+			size_t lo = 0, hi = bounds.size();
+			while (lo < hi)
+			{
+				size_t mid = (lo + hi) / 2;
+				if (!comp(key, bounds[mid]))
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			return lo;
+		}
+		const_iterator lower_bound(const Key *key, size_t sh) const
+		{
+			const_iterator it;
+			it.owner = this;
+			it.sh = sh;
+			fill(it, key, false);
+			return it;
+		}
+		// the iterator ran out of its batch, after key
+		void refill(const_iterator &it, const Key *key) const
+		{
+			Key last(*key);
+			fill(it, &last, true);
+		}
+		/**
+		* load the next batch into it: the keys of shard it.sh from key on
+		*   (after key if past, from the start if key is NULL), moving on to
+		*   later shards while they come up empty.
+		*/
+		void fill(const_iterator &it, const Key *key, bool past) const
+		{
+			it.buf.clear();
+			it.pos = 0;
+			for (; it.sh < nShards; it.sh++, key = NULL)
+			{
+				const shard &s = shards[it.sh];
+				read_guard g(s);
+				typename map<Key, T, Compare>::const_iterator p = key == NULL ? s.m.cbegin()
+					: past ? s.m.upper_bound(*key) : s.m.lower_bound(*key);
+				for (; p != s.m.cend() && it.buf.size() < BATCH; ++p)
+					it.buf.push_back(*p);
+				if (!it.buf.empty())
+					return;
+			}
+		}
+	private:
+		size_t nShards;
+		void *store;
+		shard *shards;
+		vector<Key> bounds;
+		Compare comp;
+	};
+
+}
+
+#endif
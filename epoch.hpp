@@ -0,0 +1,192 @@
+#ifndef SJTU_EPOCH_HPP
+#define SJTU_EPOCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+
+namespace sjtu {
+
+/**
+* epoch-based reclamation for lock-free containers.
+* a thread pins the current epoch (epoch_guard) while it may hold pointers
+*   into a shared structure. memory unlinked from the structure is
+*   retire()d instead of freed: it carries the epoch it was retired in and
+*   is freed once the global epoch has moved two steps past that, which
+*   can only happen after every thread pinned at the time has let go.
+* there is one domain for the whole program, so retired memory does not
+*   depend on the container it came from; each thread keeps its own list
+*   of retired blocks and a record in a list that only grows, handed on to
+*   a later thread when it exits.
+*/
+class epoch {
+private:
+	// a retired block and how to free it
+	struct retired {
+		void *p;
+		void (*drop)(void*);
+		uint64_t epoch;
+		retired *next;
+	};
+	struct record {
+		// 0 when the thread is not pinned, else the pinned epoch * 2 + 1;
+		//   64 bits, so the epoch cannot outgrow it in any process's lifetime
+		std::atomic<uint64_t> state;
+		std::atomic<bool> owned;
+		record *next;
+		// everything below is touched by the owning thread only
+		unsigned depth;
+		retired *limbo;
+		size_t pending;
+	};
+	// retire() tries to move the epoch on after this many blocks
+	static const size_t COLLECT_EVERY = 64;
+	// a thread's claim on a record, given up when the thread exits
+	class owner {
+	public:
+		owner() : rec(acquire()) {}
+		~owner()
+		{
+			advance();
+			collect(rec);
+			rec->owned.store(false, std::memory_order_release);
+		}
+		record *rec;
+	};
+public:
+	/**
+	* pins the current epoch for as long as it lives; guards nest.
+	* a guard belongs to the thread that made it.
+	*/
+	class guard {
+	public:
+		guard()
+		{
+			pin();
+		}
+		guard(const guard &)
+		{
+			pin();
+		}
+		guard & operator=(const guard &)
+		{
+			return *this;
+		}
+		~guard()
+		{
+			unpin();
+		}
+	};
+	/**
+	* hand p over for drop(p) once no thread can still see it.
+	* p must already be unreachable for threads that pin from now on.
+	*/
+	static void retire(void *p, void (*drop)(void*))
+	{
+		record *r = self();
+		retired *item = new retired;
+		item->p = p;
+		item->drop = drop;
+		item->epoch = global().load(std::memory_order_acquire);
+		item->next = r->limbo;
+		r->limbo = item;
+		if (++r->pending >= COLLECT_EVERY)
+		{
+			advance();
+			collect(r);
+		}
+	}
+private:
+	static std::atomic<uint64_t> & global()
+	{
+		static std::atomic<uint64_t> e(0);
+		return e;
+	}
+	static std::atomic<record*> & records()
+	{
+		static std::atomic<record*> head(NULL);
+		return head;
+	}
+	static record * self()
+	{
+		static thread_local owner o;
+		return o.rec;
+	}
+	// a record left by a thread that exited, or a new one
+	static record * acquire()
+	{
+		for (record *r = records().load(std::memory_order_acquire); r != NULL; r = r->next)
+		{
+			bool expected = false;
+			if (!r->owned.load(std::memory_order_relaxed) && r->owned.compare_exchange_strong(expected, true, std::memory_order_acquire))
+				return r;
+		}
+		record *r = new record;
+		r->state.store(0, std::memory_order_relaxed);
+		r->owned.store(true, std::memory_order_relaxed);
+		r->depth = 0;
+		r->limbo = NULL;
+		r->pending = 0;
+		r->next = records().load(std::memory_order_relaxed);
+		while (!records().compare_exchange_weak(r->next, r, std::memory_order_release, std::memory_order_relaxed))
+			;
+		return r;
+	}
+	static void pin()
+	{
+		record *r = self();
+		if (r->depth++ > 0)
+			return;
+		// publish the epoch, then make sure it did not move meanwhile
+		uint64_t e = global().load(std::memory_order_seq_cst);
+		for (;;)
+		{
+			r->state.store(e * 2 + 1, std::memory_order_seq_cst);
+			uint64_t now = global().load(std::memory_order_seq_cst);
+			if (now == e)
+				break;
+			e = now;
+		}
+	}
+	static void unpin()
+	{
+		record *r = self();
+		if (--r->depth == 0)
+			r->state.store(0, std::memory_order_release);
+	}
+	// move the global epoch on if every pinned thread has seen it
+	static void advance()
+	{
+		uint64_t e = global().load(std::memory_order_seq_cst);
+		for (record *r = records().load(std::memory_order_acquire); r != NULL; r = r->next)
+		{
+			uint64_t s = r->state.load(std::memory_order_seq_cst);
+			if ((s & 1) && s / 2 != e)
+				return;
+		}
+		global().compare_exchange_strong(e, e + 1, std::memory_order_seq_cst);
+	}
+	// free what r retired at least two epochs ago
+	static void collect(record *r)
+	{
+		uint64_t e = global().load(std::memory_order_acquire);
+		retired **link = &r->limbo;
+		while (*link != NULL)
+		{
+			retired *item = *link;
+			if (e - item->epoch >= 2)
+			{
+				*link = item->next;
+				item->drop(item->p);
+				delete item;
+				r->pending--;
+			}
+			else
+				link = &item->next;
+		}
+	}
+};
+
+}
+
+#endif
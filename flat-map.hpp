@@ -0,0 +1,647 @@
+/**
+* a map kept as a sorted array
+*/
+#ifndef SJTU_FLAT_MAP_HPP
+#define SJTU_FLAT_MAP_HPP
+
+#include <functional>
+#include <cstddef>
+#include <algorithm>
+#include <tuple>
+#include <utility>
+#include "utility.hpp"
+#include "exceptions.hpp"
+#include "vector.hpp"
+
+namespace sjtu {
+
+	/**
+	* an ordered map stored as a vector of pairs sorted by key.
+	* a lookup is a binary search and a scan walks contiguous memory, with no
+	*   per-element node; inserting or erasing one element moves everything
+	*   after it, so it is meant for tables that are built once, or in large
+	*   batches through insert(first, last), and mostly read.
+	* the interface follows sjtu::map, except that
+	*   value_type is pair<Key, T>: the elements are moved around, so the key
+	*   cannot be const (do not change it through an iterator),
+	*   an insert or an erase invalidates every iterator and reference.
+	*/
+	template<
+		class Key,
+		class T,
+		class Compare = std::less<Key>
+	> class flat_map {
+	public:
+		typedef pair<Key, T> value_type;
+	public:
+		class const_iterator;
+		class iterator {
+		public:
+			flat_map *owner;
+			value_type *p;
+		public:
+			iterator() {
+				owner = NULL;
+				p = NULL;
+			}
+			iterator(const iterator &other) {
+				owner = other.owner;
+				p = other.p;
+			}
+			iterator(flat_map *owner, value_type *p) {
+				this->owner = owner;
+				this->p = p;
+			}
+			iterator operator++(int)
+			{
+				iterator tmp(*this);
+				++*this;
+				return tmp;
+			}
+			iterator & operator++()
+			{
+				if (owner == NULL || p == owner->last())
+					throw index_out_of_bound();
+				++p;
+				return *this;
+			}
+			iterator operator--(int)
+			{
+				iterator tmp(*this);
+				--*this;
+				return tmp;
+			}
+			iterator & operator--()
+			{
+				if (owner == NULL || p == owner->first())
+					throw index_out_of_bound();
+				--p;
+				return *this;
+			}
+			value_type & operator*() const
+			{
+				return *p;
+			}
+			value_type* operator->() const noexcept {
+				return p;
+			}
+			bool operator==(const iterator &rhs) const
+			{
+				return owner == rhs.owner && p == rhs.p;
+			}
+			bool operator==(const const_iterator &rhs) const
+			{
+				return owner == rhs.owner && p == rhs.p;
+			}
+			bool operator!=(const iterator &rhs) const
+			{
+				return !(*this == rhs);
+			}
+			bool operator!=(const const_iterator &rhs) const
+			{
+				return !(*this == rhs);
+			}
+			iterator& operator=(const iterator &rhs) {
+				owner = rhs.owner;
+				p = rhs.p;
+				return *this;
+			}
+		};
+		class const_iterator {
+		public:
+			const flat_map *owner;
+			const value_type *p;
+		public:
+			const_iterator() {
+				owner = NULL;
+				p = NULL;
+			}
+			const_iterator(const flat_map *owner, const value_type *p) {
+				this->owner = owner;
+				this->p = p;
+			}
+			const_iterator(const const_iterator &other) {
+				owner = other.owner;
+				p = other.p;
+			}
+			const_iterator(const iterator &other) {
+				owner = other.owner;
+				p = other.p;
+			}
+			const_iterator& operator=(const const_iterator &other) {
+				owner = other.owner;
+				p = other.p;
+				return *this;
+			}
+			bool operator==(const const_iterator &other) const {
+				return owner == other.owner && p == other.p;
+			}
+			bool operator!=(const const_iterator &other) const {
+				return !(*this == other);
+			}
+			const value_type* operator->() const {
+				return p;
+			}
+			const value_type & operator*() const
+			{
+				return *p;
+			}
+			const_iterator operator++(int)
+			{
+				const_iterator tmp(*this);
+				++*this;
+				return tmp;
+			}
+			const_iterator & operator++()
+			{
+				if (owner == NULL || p == owner->last())
+					throw index_out_of_bound();
+				++p;
+				return *this;
+			}
+			const_iterator operator--(int)
+			{
+				const_iterator tmp(*this);
+				--*this;
+				return tmp;
+			}
+			const_iterator & operator--()
+			{
+				if (owner == NULL || p == owner->first())
+					throw index_out_of_bound();
+				--p;
+				return *this;
+			}
+		};
+
+		flat_map() {}
+		flat_map(const flat_map &other) : elems(other.elems), comp(other.comp) {}
+		/**
+		* construct from the pairs in [first, last), see insert(first, last).
+		*/
+		template<class InputIt>
+		flat_map(InputIt first, InputIt last) {
+			insert(first, last);
+		}
+		// other is left empty
+		flat_map(flat_map &&other) : elems(std::move(other.elems)), comp(other.comp) {}
+		flat_map & operator=(const flat_map &other) {
+			elems = other.elems;
+			comp = other.comp;
+			return *this;
+		}
+		flat_map & operator=(flat_map &&other) {
+			if (this != &other)
+			{
+				elems = std::move(other.elems);
+				other.elems.clear();
+				comp = other.comp;
+			}
+			return *this;
+		}
+		/**
+		* access specified element with bounds checking
+		* Returns a reference to the mapped value of the element with key equivalent to key.
+		* If no such element exists, an exception of type `index_out_of_bound'
+		*/
+		T & at(const Key &key)
+		{
+			iterator it = find(key);
+			if (it.p == last())
+				throw index_out_of_bound();
+			return it->second;
+		}
+		const T & at(const Key &key) const
+		{
+			const_iterator it = find(key);
+			if (it.p == last())
+				throw index_out_of_bound();
+			return it->second;
+		}
+		/**
+		* with a transparent Compare (one that defines is_transparent, like
+		*   std::less<>) at, count, find, lower_bound, upper_bound and erase
+		*   also take any key type Compare can compare with Key, so no Key is
+		*   built to look up.
+		*/
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		T & at(const K &key)
+		{
+			iterator it = find(key);
+			if (it.p == last())
+				throw index_out_of_bound();
+			return it->second;
+		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		const T & at(const K &key) const
+		{
+			const_iterator it = find(key);
+			if (it.p == last())
+				throw index_out_of_bound();
+			return it->second;
+		}
+		/**
+		* access specified element
+		* Returns a reference to the value that is mapped to a key equivalent to key,
+		*   performing an insertion if such key does not already exist.
+		*/
+		T & operator[](const Key &key)
+		{
+			size_t i = lowerIndex(key);
+			if (i == elems.size() || comp(key, elems[i].first))
+				insertAt(i, value_type(key, T()));
+			return elems[i].second;
+		}
+		/**
+		* behave like at() throw index_out_of_bound if such key does not exist.
+		*/
+		const T & operator[](const Key &key) const
+		{
+			return at(key);
+		}
+		iterator begin() {
+			return iterator(this, first());
+		}
+		const_iterator begin() const {
+			return const_iterator(this, first());
+		}
+		const_iterator cbegin() const {
+			return const_iterator(this, first());
+		}
+		iterator end() {
+			return iterator(this, last());
+		}
+		const_iterator end() const {
+			return const_iterator(this, last());
+		}
+		const_iterator cend() const {
+			return const_iterator(this, last());
+		}
+		bool empty() const {
+			return elems.empty();
+		}
+		size_t size() const {
+			return elems.size();
+		}
+		/**
+		* clears the contents
+		*/
+		void clear()
+		{
+			elems.clear();
+		}
+		/**
+		* insert an element, moving the ones after it up by one.
+		* return a pair, the first of the pair is
+		*   the iterator to the new element (or the element that prevented the insertion),
+		*   the second one is true if insert successfully, or false.
+		*/
+		pair<iterator, bool> insert(const value_type &value) {
+			return insertUnique(value);
+		}
+		pair<iterator, bool> insert(value_type &&value) {
+			return insertUnique(std::move(value));
+		}
+		/**
+		* insert value as close as possible to the position just before hint.
+		* when the key belongs right there the binary search is skipped, so
+		*   sorted input fed with end() or the previous result as hint only
+		*   compares each key with its two neighbours.
+		* return an iterator to the new element or to the one that prevented the insertion.
+		*/
+		iterator insert(const_iterator hint, const value_type &value) {
+			return insertHinted(hint, value);
+		}
+		iterator insert(const_iterator hint, value_type &&value) {
+			return insertHinted(hint, std::move(value));
+		}
+		template<class... Args>
+		iterator emplace_hint(const_iterator hint, Args&&... args) {
+			return insertHinted(hint, value_type(std::forward<Args>(args)...));
+		}
+		/**
+		* insert a value built from args.
+		* its place depends on the key, so the value is built first and moved
+		*   into the array; it is dropped again if the key already exists.
+		* return value is the same as insert().
+		*/
+		template<class... Args>
+		pair<iterator, bool> emplace(Args&&... args) {
+			return insertUnique(value_type(std::forward<Args>(args)...));
+		}
+		/**
+		* insert key with a value built from args, if key is not present yet.
+		* nothing is constructed when key already exists.
+		* return value is the same as insert().
+		*/
+		template<class... Args>
+		pair<iterator, bool> try_emplace(const Key &key, Args&&... args) {
+			size_t i = lowerIndex(key);
+			if (i < elems.size() && !comp(key, elems[i].first))
+				return pair<iterator, bool>(iterator(this, first() + i), false);
+			insertAt(i, value_type(std::piecewise_construct,
+				std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...)));
+			return pair<iterator, bool>(iterator(this, first() + i), true);
+		}
+		/**
+		* insert (key, obj), or assign obj to the element that already has key.
+		* the second of the returned pair is true if a new element was inserted.
+		*/
+		template<class M>
+		pair<iterator, bool> insert_or_assign(const Key &key, M &&obj) {
+			size_t i = lowerIndex(key);
+			if (i < elems.size() && !comp(key, elems[i].first))
+			{
+				elems[i].second = std::forward<M>(obj);
+				return pair<iterator, bool>(iterator(this, first() + i), false);
+			}
+			insertAt(i, value_type(key, std::forward<M>(obj)));
+			return pair<iterator, bool>(iterator(this, first() + i), true);
+		}
+		/**
+		* insert the pairs in [first, last) whose key is not in the map yet;
+		*   the first of equal keys wins, as with insert one by one.
+		* the new pairs are sorted on their own and merged into the array from
+		*   the back in one pass: O(n + m log m) for m pairs instead of O(n m).
+		*/
+		template<class InputIt>
+		void insert(InputIt first, InputIt last)
+		{
+			vector<value_type> fresh;
+			for (; first != last; ++first)
+				fresh.push_back(value_type((*first).first, (*first).second));
+			if (fresh.empty())
+				return;
+			value_type *f = &fresh[0];
+			size_t m = fresh.size();
+			std::stable_sort(f, f + m, [this](const value_type &a, const value_type &b) {
+				return comp(a.first, b.first);
+			});
+			// keep the first of equal keys and drop the keys the map already has
+			size_t k = 0;
+			size_t n = elems.size();
+			const value_type *a = this->first();
+			for (size_t i = 0, j = 0; i < m; i++)
+			{
+				if (k > 0 && !comp(f[k - 1].first, f[i].first))
+					continue;
+				while (j < n && comp(a[j].first, f[i].first))
+					j++;
+				if (j < n && !comp(f[i].first, a[j].first))
+					continue;
+				if (k != i)
+					f[k] = std::move(f[i]);
+				k++;
+			}
+			if (k == 0)
+				return;
+			// grow by k, then fill the array from its end
+			for (size_t i = 0; i < k; i++)
+				elems.push_back(f[i]);
+			value_type *e = this->first();
+			size_t w = n + k;
+			while (k > 0)
+			{
+				if (n > 0 && comp(f[k - 1].first, e[n - 1].first))
+					e[--w] = std::move(e[--n]);
+				else
+					e[--w] = std::move(f[--k]);
+			}
+		}
+		/**
+		* erase the element at pos and return the iterator following it.
+		*
+		* throw if pos pointed to a bad element (pos == this->end() || pos points an element out of this)
+		*/
+		iterator erase(iterator pos)
+		{
+			if (pos.owner != this)
+				throw invalid_iterator();
+			if (pos.p == last())
+				throw index_out_of_bound();
+			if (pos.p < first() || pos.p > last())
+				throw invalid_iterator();
+			size_t i = pos.p - first();
+			eraseAt(i);
+			return iterator(this, first() + i);
+		}
+		/**
+		* erase the element with key, if any.
+		* returns the number of elements removed (0 or 1).
+		*/
+		size_t erase(const Key &key)
+		{
+			return eraseKey(key);
+		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		size_t erase(const K &key)
+		{
+			return eraseKey(key);
+		}
+		/**
+		* Returns the number of elements with key
+		*   that compares equivalent to the specified argument,
+		*   which is either 1 or 0
+		*/
+		size_t count(const Key &key) const
+		{
+			return findIndex(key) == elems.size() ? 0 : 1;
+		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		size_t count(const K &key) const
+		{
+			return findIndex(key) == elems.size() ? 0 : 1;
+		}
+		/**
+		* Finds an element with key equivalent to key.
+		* key value of the element to search for.
+		* Iterator to an element with key equivalent to key.
+		*   If no such element is found, past-the-end (see end()) iterator is returned.
+		*/
+		iterator find(const Key &key)
+		{
+			return iterator(this, first() + findIndex(key));
+		}
+		const_iterator find(const Key &key) const
+		{
+			return const_iterator(this, first() + findIndex(key));
+		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		iterator find(const K &key)
+		{
+			return iterator(this, first() + findIndex(key));
+		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		const_iterator find(const K &key) const
+		{
+			return const_iterator(this, first() + findIndex(key));
+		}
+		/**
+		* the first element whose key is not less than key, end() if none.
+		*/
+		iterator lower_bound(const Key &key)
+		{
+			return iterator(this, first() + lowerIndex(key));
+		}
+		const_iterator lower_bound(const Key &key) const
+		{
+			return const_iterator(this, first() + lowerIndex(key));
+		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		iterator lower_bound(const K &key)
+		{
+			return iterator(this, first() + lowerIndex(key));
+		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		const_iterator lower_bound(const K &key) const
+		{
+			return const_iterator(this, first() + lowerIndex(key));
+		}
+		/**
+		* the first element whose key is greater than key, end() if none.
+		*/
+		iterator upper_bound(const Key &key)
+		{
+			return iterator(this, first() + upperIndex(key));
+		}
+		const_iterator upper_bound(const Key &key) const
+		{
+			return const_iterator(this, first() + upperIndex(key));
+		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		iterator upper_bound(const K &key)
+		{
+			return iterator(this, first() + upperIndex(key));
+		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		const_iterator upper_bound(const K &key) const
+		{
+			return const_iterator(this, first() + upperIndex(key));
+		}
+		/**
+		* the elements with key equivalent to key: [lower_bound, upper_bound).
+		*/
+		pair<iterator, iterator> equal_range(const Key &key)
+		{
+			size_t i = lowerIndex(key);
+			size_t j = i < elems.size() && !comp(key, elems[i].first) ? i + 1 : i;
+			return pair<iterator, iterator>(iterator(this, first() + i), iterator(this, first() + j));
+		}
+		pair<const_iterator, const_iterator> equal_range(const Key &key) const
+		{
+			size_t i = lowerIndex(key);
+			size_t j = i < elems.size() && !comp(key, elems[i].first) ? i + 1 : i;
+			return pair<const_iterator, const_iterator>(const_iterator(this, first() + i), const_iterator(this, first() + j));
+		}
+	private:
+		template<class V>
+		pair<iterator, bool> insertUnique(V &&value)
+		{
+			size_t i = lowerIndex(value.first);
+			if (i < elems.size() && !comp(value.first, elems[i].first))
+				return pair<iterator, bool>(iterator(this, first() + i), false);
+			insertAt(i, std::forward<V>(value));
+			return pair<iterator, bool>(iterator(this, first() + i), true);
+		}
+		// insertUnique, trying the slot of hint (the end for end()) before searching
+		template<class V>
+		iterator insertHinted(const_iterator hint, V &&value)
+		{
+			if (hint.owner != this)
+				return insertUnique(std::forward<V>(value)).first;
+			size_t i = hint.p - first();
+			const value_type *a = first();
+			if ((i > 0 && !comp(a[i - 1].first, value.first)) || (i < elems.size() && !comp(value.first, a[i].first)))
+				return insertUnique(std::forward<V>(value)).first;
+			insertAt(i, std::forward<V>(value));
+			return iterator(this, first() + i);
+		}
+		// the slot holding key, size() if there is none
+		template<class K>
+		size_t findIndex(const K &key) const
+		{
+			size_t i = lowerIndex(key);
+			if (i == elems.size() || comp(key, elems[i].first))
+				return elems.size();
+			return i;
+		}
+		template<class K>
+		size_t eraseKey(const K &key)
+		{
+			size_t i = findIndex(key);
+			if (i == elems.size())
+				return 0;
+			eraseAt(i);
+			return 1;
+		}
+		// the array itself, NULL while it is empty
+		value_type * first()
+		{
+			return elems.empty() ? NULL : &elems[0];
+		}
+		const value_type * first() const
+		{
+			return elems.empty() ? NULL : &elems[0];
+		}
+		value_type * last()
+		{
+			return first() + elems.size();
+		}
+		const value_type * last() const
+		{
+			return first() + elems.size();
+		}
+		// the number of elements whose key is less than key
+		template<class K>
+		size_t lowerIndex(const K &key) const
+		{
+			const value_type *a = first();
+			size_t lo = 0, hi = elems.size();
+			while (lo < hi)
+			{
+				size_t mid = (lo + hi) / 2;
+				if (comp(a[mid].first, key))
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			return lo;
+		}
+		// the number of elements whose key is not greater than key
+		template<class K>
+		size_t upperIndex(const K &key) const
+		{
+			const value_type *a = first();
+			size_t lo = 0, hi = elems.size();
+			while (lo < hi)
+			{
+				size_t mid = (lo + hi) / 2;
+				if (!comp(key, a[mid].first))
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			return lo;
+		}
+		// append, then rotate the new last element down to i
+		template<class V>
+		void insertAt(size_t i, V &&value)
+		{
+			elems.push_back(std::forward<V>(value));
+			value_type *a = first();
+			std::rotate(a + i, a + elems.size() - 1, a + elems.size());
+		}
+		void eraseAt(size_t i)
+		{
+			value_type *a = first();
+			std::rotate(a + i, a + i + 1, a + elems.size());
+			elems.pop_back();
+		}
+	private:
+		vector<value_type> elems;
+		Compare comp;
+	};
+
+}
+
+#endif
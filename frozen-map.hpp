@@ -0,0 +1,315 @@
+/**
+* a read-only map searched in Eytzinger order
+*/
+#ifndef SJTU_FROZEN_MAP_HPP
+#define SJTU_FROZEN_MAP_HPP
+
+#include <functional>
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include "utility.hpp"
+#include "exceptions.hpp"
+
+namespace sjtu {
+
+	/**
+	* an immutable ordered map, see map::freeze().
+	* the elements sit in one array in key order, so iteration is a pointer
+	*   walk. a second array holds the keys in Eytzinger order, the
+	*   breadth-first order of a complete search tree: slot k has its
+	*   children at 2k and 2k + 1. a search reads one key per level with no
+	*   branch on the comparison, and prefetches the line holding the
+	*   descendants four levels down, so the top levels stay in cache and
+	*   the misses further down overlap.
+	*/
+	template<
+		class Key,
+		class T,
+		class Compare = std::less<Key>
+	> class frozen_map {
+	public:
+		typedef pair<const Key, T> value_type;
+		class const_iterator {
+		public:
+			const frozen_map *owner;
+			const value_type *p;
+		public:
+			const_iterator() {
+				owner = NULL;
+				p = NULL;
+			}
+			const_iterator(const frozen_map *owner, const value_type *p) {
+				this->owner = owner;
+				this->p = p;
+			}
+			const_iterator(const const_iterator &other) {
+				owner = other.owner;
+				p = other.p;
+			}
+			const_iterator& operator=(const const_iterator &other) {
+				owner = other.owner;
+				p = other.p;
+				return *this;
+			}
+			bool operator==(const const_iterator &other) const {
+				return owner == other.owner && p == other.p;
+			}
+			bool operator!=(const const_iterator &other) const {
+				return !(*this == other);
+			}
+			const value_type* operator->() const {
+				return p;
+			}
+			const value_type & operator*() const
+			{
+				return *p;
+			}
+			const_iterator operator++(int)
+			{
+				const_iterator tmp(*this);
+				++*this;
+				return tmp;
+			}
+			const_iterator & operator++()
+			{
+				if (owner == NULL || p == owner->elems + owner->_size)
+					throw index_out_of_bound();
+				++p;
+				return *this;
+			}
+			const_iterator operator--(int)
+			{
+				const_iterator tmp(*this);
+				--*this;
+				return tmp;
+			}
+			const_iterator & operator--()
+			{
+				if (owner == NULL || p == owner->elems)
+					throw index_out_of_bound();
+				--p;
+				return *this;
+			}
+		};
+		// nothing in a frozen map can be changed
+		typedef const_iterator iterator;
+
+		frozen_map() : _size(0), elems(NULL), keys(NULL), slot(NULL) {}
+		/**
+		* the pairs in [first, last), which must be sorted by key (under comp)
+		*   without duplicates; throw runtime_error if they are not.
+		* the range is walked twice, to count it and to copy it.
+		*/
+		template<class ForwardIt>
+		frozen_map(ForwardIt first, ForwardIt last, const Compare &comp = Compare()) : _size(0), elems(NULL), keys(NULL), slot(NULL), comp(comp) {
+			size_t n = 0;
+			for (ForwardIt it = first; it != last; ++it)
+				n++;
+			build(first, n);
+		}
+		frozen_map(const frozen_map &other) : _size(0), elems(NULL), keys(NULL), slot(NULL), comp(other.comp) {
+			build(other.elems, other._size);
+		}
+		frozen_map(frozen_map &&other) : _size(other._size), elems(other.elems), keys(other.keys), slot(other.slot), comp(other.comp) {
+			other._size = 0;
+			other.elems = NULL;
+			other.keys = NULL;
+			other.slot = NULL;
+		}
+		frozen_map & operator=(const frozen_map &other) {
+			if (this != &other)
+			{
+				destroy();
+				comp = other.comp;
+				build(other.elems, other._size);
+			}
+			return *this;
+		}
+		~frozen_map() {
+			destroy();
+		}
+		/**
+		* the mapped value of key, throw index_out_of_bound if there is none.
+		*/
+		const T & at(const Key &key) const
+		{
+			const_iterator it = find(key);
+			if (it.p == elems + _size)
+				throw index_out_of_bound();
+			return it->second;
+		}
+		const T & operator[](const Key &key) const
+		{
+			return at(key);
+		}
+		const_iterator begin() const {
+			return const_iterator(this, elems);
+		}
+		const_iterator cbegin() const {
+			return const_iterator(this, elems);
+		}
+		const_iterator end() const {
+			return const_iterator(this, elems + _size);
+		}
+		const_iterator cend() const {
+			return const_iterator(this, elems + _size);
+		}
+		bool empty() const {
+			return _size == 0;
+		}
+		size_t size() const {
+			return _size;
+		}
+		size_t count(const Key &key) const
+		{
+			return find(key).p == elems + _size ? 0 : 1;
+		}
+		const_iterator find(const Key &key) const
+		{
+			size_t k = lowerSlot(key);
+			if (k == 0 || comp(key, keys[k]))
+				return end();
+			return const_iterator(this, elems + slot[k]);
+		}
+		/**
+		* the first element whose key is not less than key, end() if none.
+		*/
+		const_iterator lower_bound(const Key &key) const
+		{
+			size_t k = lowerSlot(key);
+			return const_iterator(this, elems + (k == 0 ? _size : slot[k]));
+		}
+		/**
+		* the first element whose key is greater than key, end() if none.
+		*/
+		const_iterator upper_bound(const Key &key) const
+		{
+			size_t k = upperSlot(key);
+			return const_iterator(this, elems + (k == 0 ? _size : slot[k]));
+		}
+	private:
+		// keys per cache line: the line at k * LINE holds descendants of slot k log2(LINE) levels down;
+		// near the bottom that is past keys[size], so the address is clamped to stay in the array
+		static const size_t LINE = sizeof(Key) >= 64 ? 1 : 64 / sizeof(Key);
+
+		static void prefetch(const void *p)
+		{
+#if defined(__GNUC__)
+			__builtin_prefetch(p);
+#else
+			(void)p;
+#endif
+		}
+		/**
+		* the descent goes right exactly when the key at k is on the wrong side,
+		*   so the bits of k after the leading one spell the path. the answer
+		*   is where it last went left: drop the trailing ones and one more bit.
+		*/
+		static size_t lastLeft(size_t k)
+		{
+			while (k & 1)
+				k >>= 1;
+			return k >> 1;
+		}
+		// the Eytzinger slot of the first key not less than key, 0 if none
+		size_t lowerSlot(const Key &key) const
+		{
+			size_t k = 1;
+			while (k <= _size)
+			{
+				prefetch(keys + std::min(k * LINE, _size));
+				k = 2 * k + comp(keys[k], key);
+			}
+			return lastLeft(k);
+		}
+		// the Eytzinger slot of the first key greater than key, 0 if none
+		size_t upperSlot(const Key &key) const
+		{
+			size_t k = 1;
+			while (k <= _size)
+			{
+				prefetch(keys + std::min(k * LINE, _size));
+				k = 2 * k + !comp(key, keys[k]);
+			}
+			return lastLeft(k);
+		}
+		// copy n sorted pairs from first, then lay the keys out breadth-first
+		template<class It>
+		void build(It first, size_t n)
+		{
+			if (n == 0)
+				return;
+			elems = static_cast<value_type*>(::operator new(n * sizeof(value_type)));
+			try {
+				for (; _size < n; ++first)
+				{
+					if (_size > 0 && !comp(elems[_size - 1].first, (*first).first))
+						throw runtime_error();
+					new (elems + _size) value_type((*first).first, (*first).second);
+					_size++;
+				}
+				keys = static_cast<Key*>(::operator new((n + 1) * sizeof(Key)));
+				slot = new size_t[n + 1];
+				// n marks a slot whose key is not built yet
+				for (size_t k = 0; k <= n; k++)
+					slot[k] = n;
+				size_t placed = 0;
+				try {
+					layout(1, placed);
+				}
+				catch (...) {
+					for (size_t k = 1; k <= n; k++)
+						if (slot[k] < placed)
+							keys[k].~Key();
+					throw;
+				}
+			}
+			catch (...) {
+				delete [] slot;
+				::operator delete(keys);
+				slot = NULL;
+				keys = NULL;
+				destroy();
+				throw;
+			}
+		}
+		// fill the subtree at slot k in order, from the element placed on
+		void layout(size_t k, size_t &placed)
+		{
+			if (k > _size)
+				return;
+			layout(2 * k, placed);
+			new (keys + k) Key(elems[placed].first);
+			slot[k] = placed++;
+			layout(2 * k + 1, placed);
+		}
+		void destroy()
+		{
+			if (keys != NULL)
+			{
+				for (size_t k = 1; k <= _size; k++)
+					keys[k].~Key();
+				::operator delete(keys);
+				delete [] slot;
+			}
+			for (size_t i = 0; i < _size; i++)
+				elems[i].~value_type();
+			::operator delete(elems);
+			_size = 0;
+			elems = NULL;
+			keys = NULL;
+			slot = NULL;
+		}
+	private:
+		size_t _size;
+		value_type *elems;
+		// keys[1 .. size] in Eytzinger order, slot[k] is where keys[k] sits in elems
+		Key *keys;
+		size_t *slot;
+		Compare comp;
+	};
+
+}
+
+#endif
@@ -7,8 +7,18 @@
 #include<cstdio>
 #include<cstdlib>
 #include<cstring>
+#include<string>
 #include<algorithm>
+#include<thread>
+#include<atomic>
+#include<mutex>
 #include "map.hpp"
+#include "btree.hpp"
+#include "flat-map.hpp"
+#include "concurrent-map.hpp"
+#include "skiplist-map.hpp"
+#include "persistent-map.hpp"
+#include "vector.hpp"
 
 using namespace std;
 
@@ -504,6 +514,997 @@ bool check13() {// have fun
 	if (it->first != 3225 || it->second != 1) return 0;
 	return 1;
 }
+bool check14() {// try_emplace && insert_or_assign
+	sjtu::map<int, string> Q;
+	std::map<int, string> stdQ;
+	for (int i = 1; i <= 20000; i++) {
+		int a = rand() % 5000;
+		string b = to_string(rand());
+		if (i & 1) {
+			bool ok = Q.try_emplace(a, b).second;
+			if (ok != stdQ.insert(std::map<int, string>::value_type(a, b)).second) return 0;
+		}
+		else {
+			sjtu::pair<sjtu::map<int, string>::iterator, bool> res = Q.insert_or_assign(a, b);
+			if (res.second == (stdQ.count(a) > 0)) return 0;
+			stdQ[a] = b;
+			if (res.first->first != a || res.first->second != b) return 0;
+		}
+	}
+	if (Q.try_emplace(stdQ.begin()->first, 3, 'x').first->second != stdQ.begin()->second) return 0;
+	if (Q.try_emplace(-1, 3, 'x').first->second != "xxx") return 0;
+	sjtu::map<int, std::mutex> locks;
+	if (!locks.try_emplace(1).second || locks.try_emplace(1).second || locks.size() != 1) return 0;
+	stdQ[-1] = "xxx";
+	if (Q.size() != stdQ.size()) return 0;
+	sjtu::map<int, string>::iterator it = Q.begin();
+	for (std::map<int, string>::iterator stdit = stdQ.begin(); stdit != stdQ.end(); stdit++, it++) {
+		if (stdit->first != it->first || stdit->second != it->second) return 0;
+	}
+	return 1;
+}
+class heavy {
+public:
+	static int copies;
+	string s;
+	heavy() {}
+	heavy(const string &s) : s(s) {}
+	heavy(size_t n, char c) : s(n, c) {}
+	heavy(const heavy &other) : s(other.s) { copies++; }
+	heavy(heavy &&other) : s(std::move(other.s)) {}
+	heavy & operator=(const heavy &other) { s = other.s; copies++; return *this; }
+	heavy & operator=(heavy &&other) { s = std::move(other.s); return *this; }
+};
+int heavy::copies = 0;
+bool check15() {// emplace && rvalue insert && erase keep values where they are
+	sjtu::map<int, heavy> Q;
+	heavy::copies = 0;
+	for (int i = 1; i <= 3000; i++) {
+		Q.emplace(i * 2, heavy(to_string(i)));
+		Q.insert(sjtu::map<int, heavy>::value_type(i * 2 + 1, heavy(to_string(i))));
+		Q[i * 2 + 10000] = heavy(to_string(i));
+		Q.try_emplace(i * 2 + 20000, 5, 'x');
+	}
+	if (Q.emplace(2, heavy("dup")).second || Q.find(2)->second.s != "1") return 0;
+	if (heavy::copies != 0 || Q.size() != 12000) return 0;
+	sjtu::map<int, heavy>::iterator keep = Q.find(3001), it;
+	heavy *addr = &keep->second;
+	for (int i = 1; i <= 3000; i++) {
+		if (i == 1500) continue;
+		it = Q.find(i % 2 ? i * 2 : i * 2 + 1);
+		Q.erase(it);
+	}
+	if (heavy::copies != 0 || Q.size() != 9001) return 0;
+	if (keep->first != 3001 || &keep->second != addr || keep->second.s != "1500") return 0;
+	return 1;
+}
+bool check16() {// insert with hint
+	sjtu::map<int, int> Q;
+	std::map<int, int> stdQ;
+	sjtu::map<int, int>::iterator hint = Q.end();
+	for (int i = 1; i <= 30000; i++) {
+		int a = (i % 7 == 0) ? rand() % 100000 : i * 3 + rand() % 3;
+		int b = rand();
+		if (i % 3 == 0) hint = Q.end();
+		if (i % 5 == 0) hint = Q.begin();
+		if (i & 1) hint = Q.insert(hint, sjtu::map<int, int>::value_type(a, b));
+		else hint = Q.emplace_hint(hint, a, b);
+		stdQ.insert(std::map<int, int>::value_type(a, b));
+		if (hint->first != a || hint->second != stdQ[a]) return 0;
+	}
+	if (Q.size() != stdQ.size()) return 0;
+	sjtu::map<int, int>::iterator it = Q.begin();
+	for (std::map<int, int>::iterator stdit = stdQ.begin(); stdit != stdQ.end(); stdit++, it++) {
+		if (stdit->first != it->first || stdit->second != it->second) return 0;
+	}
+	return 1;
+}
+bool check17() {// build from a sorted vector
+	sjtu::vector<sjtu::pair<int, int> > v;
+	std::map<int, int> stdQ;
+	int a = 0;
+	for (int i = 1; i <= 30000; i++) {
+		a += rand() % 10 + 1;
+		int b = rand();
+		v.push_back(sjtu::pair<int, int>(a, b));
+		stdQ[a] = b;
+	}
+	sjtu::map<int, int> Q(v), P;
+	P[-1] = 1;
+	P.assign_sorted(v);
+	for (int i = 1; i <= 5000; i++) {
+		a = rand() % 300000;
+		if (Q.count(a)) { Q.erase(Q.find(a)); P.erase(P.find(a)); stdQ.erase(a); }
+		else { Q[a] = a; P[a] = a; stdQ[a] = a; }
+	}
+	if (Q.size() != stdQ.size() || P.size() != stdQ.size()) return 0;
+	sjtu::map<int, int>::iterator it = Q.begin(), pit = P.begin();
+	for (std::map<int, int>::iterator stdit = stdQ.begin(); stdit != stdQ.end(); stdit++, it++, pit++) {
+		if (stdit->first != it->first || stdit->second != it->second) return 0;
+		if (stdit->first != pit->first || stdit->second != pit->second) return 0;
+	}
+	v.push_back(sjtu::pair<int, int>(0, 0));
+	try {
+		P.assign_sorted(v);
+		return 0;
+	}
+	catch (...) {}
+	return P.size() == stdQ.size();
+}
+class label {
+public:
+	static int built;
+	string s;
+	label(const char *p) : s(p) { built++; }
+	label(const label &other) : s(other.s) { built++; }
+};
+int label::built = 0;
+class label_less {
+public:
+	typedef void is_transparent;
+	bool operator () (const label &a, const label &b) const { return a.s < b.s; }
+	bool operator () (const label &a, const char *b) const { return a.s.compare(b) < 0; }
+	bool operator () (const char *a, const label &b) const { return b.s.compare(a) > 0; }
+};
+bool check18() {// lookup with a transparent comparator builds no key
+	sjtu::map<label, int, label_less> Q;
+	const char *names[] = { "aa", "bb", "cc", "lucky", "lwher", "zz" };
+	for (int i = 0; i < 6; i++) Q.insert(sjtu::map<label, int, label_less>::value_type(names[i], i));
+	const sjtu::map<label, int, label_less> &C = Q;
+	label::built = 0;
+	if (Q.at("lucky") != 3 || C.at("lwher") != 4) return 0;
+	if (Q.count("cc") != 1 || C.count("dd") != 0) return 0;
+	if (Q.find("bb")->second != 1 || C.find("zz")->second != 5) return 0;
+	if (Q.find("b") != Q.end() || C.find("zzz") != C.cend()) return 0;
+	if (Q.lower_bound("c")->second != 2 || C.lower_bound("m")->second != 5) return 0;
+	if (Q.lower_bound("zzz") != Q.end()) return 0;
+	if (Q.erase("dd") != 0 || Q.erase("cc") != 1 || Q.count("cc") != 0) return 0;
+	int OK = 0;
+	try { Q.at("cc"); } catch (...) { OK++; }
+	return OK == 1 && label::built == 0 && Q.size() == 5;
+}
+bool check19() {// lower_bound && upper_bound && equal_range && range
+	sjtu::map<int, int> Q;
+	std::map<int, int> stdQ;
+	for (int i = 1; i <= 20000; i++) {
+		int a = rand() % 100000, b = rand();
+		Q[a] = b; stdQ[a] = b;
+	}
+	const sjtu::map<int, int> &C = Q;
+	for (int i = 1; i <= 2000; i++) {
+		int lo = rand() % 110000 - 5000, hi = lo + rand() % 3000;
+		sjtu::map<int, int>::iterator it = Q.lower_bound(lo);
+		std::map<int, int>::iterator stdit = stdQ.lower_bound(lo);
+		if ((it == Q.end()) != (stdit == stdQ.end())) return 0;
+		if (it != Q.end() && it->first != stdit->first) return 0;
+		it = Q.upper_bound(lo); stdit = stdQ.upper_bound(lo);
+		if ((it == Q.end()) != (stdit == stdQ.end())) return 0;
+		if (it != Q.end() && it->first != stdit->first) return 0;
+		sjtu::pair<sjtu::map<int, int>::const_iterator, sjtu::map<int, int>::const_iterator> eq = C.equal_range(lo);
+		int n = 0;
+		for (sjtu::map<int, int>::const_iterator cit = eq.first; cit != eq.second; ++cit) n++;
+		if (n != (int)stdQ.count(lo)) return 0;
+		stdit = stdQ.lower_bound(lo);
+		n = 0;
+		for (sjtu::pair<const int, int> &v : Q.range(lo, hi)) {
+			if (stdit == stdQ.end() || v.first != stdit->first || v.second != stdit->second) return 0;
+			stdit++; n++;
+		}
+		if (stdit != stdQ.lower_bound(hi) && lo < hi) return 0;
+		if (!C.range(hi, lo).empty() && lo != hi) return 0;
+	}
+	return 1;
+}
+bool check20() {// rank && select && iterator arithmetic
+	typedef sjtu::map<int, int, std::less<int>, sjtu::order_statistic> ranked;
+	ranked Q;
+	std::map<int, int> stdQ;
+	for (int i = 1; i <= 30000; i++) {
+		int a = rand() % 20000;
+		if (rand() % 3) { Q[a] = i; stdQ[a] = i; }
+		else { Q.erase(a); stdQ.erase(a); }
+	}
+	ranked C(Q);
+	int n = 0;
+	for (std::map<int, int>::iterator stdit = stdQ.begin(); stdit != stdQ.end(); ++stdit, ++n) {
+		if (Q.rank(stdit->first) != (size_t)n || C.select(n)->first != stdit->first) return 0;
+		if ((Q.begin() + n)->first != stdit->first || Q.find(stdit->first) - Q.begin() != n) return 0;
+	}
+	if (Q.select(n) != Q.end() || Q.end() - Q.begin() != n || Q.rank(20000) != (size_t)n) return 0;
+	for (int i = 1; i <= 2000; i++) {
+		int a = rand() % n, b = rand() % n;
+		ranked::const_iterator it = C.select(a);
+		it += b - a;
+		if (it->first != C.select(b)->first) return 0;
+		if ((Q.end() - (n - a))->first != C.select(a)->first) return 0;
+	}
+	try { Q.begin() - 1; return 0; } catch (...) {}
+	try { Q.end() + 1; return 0; } catch (...) {}
+	return 1;
+}
+class bytes_sum {
+public:
+	typedef long long value_type;
+	static value_type identity() { return 0; }
+	static value_type combine(const value_type &a, const value_type &b) { return a + b; }
+	static value_type measure(const sjtu::pair<const int, int> &kv) { return kv.second; }
+};
+bool check21() {// range_reduce && refresh, operator[] keeps the aggregate
+	typedef sjtu::map<int, int, std::less<int>, sjtu::aggregate<bytes_sum> > summed;
+	summed Q;
+	std::map<int, int> stdQ;
+	for (int i = 1; i <= 30000; i++) {
+		int a = rand() % 20000, b = rand() % 1000;
+		if (rand() % 4 == 0) { Q.erase(a); stdQ.erase(a); }
+		else if (rand() % 2) { Q.insert_or_assign(a, b); stdQ[a] = b; }
+		else if (rand() % 2) { Q[a] = b; stdQ[a] = b; }
+		else { Q[a]; Q.find(a)->second = b; Q.refresh(Q.find(a)); stdQ[a] = b; }
+	}
+	Q[3] = Q[5]; stdQ[3] = stdQ[5];// operator[] refreshes on its own
+	const int &v = Q[3];
+	if (v != stdQ[3] || Q[3].get() != stdQ[3]) return 0;
+	summed C;
+	C = Q;
+	for (int i = 1; i <= 300; i++) {
+		int lo = rand() % 21000 - 500, hi = lo + rand() % 5000;
+		long long sum = 0;
+		for (std::map<int, int>::iterator it = stdQ.lower_bound(lo); it != stdQ.end() && it->first < hi; ++it)
+			sum += it->second;
+		if (Q.range_reduce(lo, hi) != sum || C.range_reduce(lo, hi) != sum) return 0;
+	}
+	if (Q.range_reduce(5, 5) != 0 || Q.range_reduce(10, 0) != 0) return 0;
+	try { Q.refresh(Q.end()); return 0; } catch (...) {}
+	return 1;
+}
+bool check22() {// btree_map against std::map
+	sjtu::btree_map<int, int> Q;
+	std::map<int, int> stdQ;
+	for (int i = 1; i <= 200000; i++) {
+		int a = rand() % 30000, op = rand() % 4;
+		if (op == 0) { Q[a] = i; stdQ[a] = i; }
+		else if (op == 1) {
+			if (Q.insert(sjtu::btree_map<int, int>::value_type(a, i)).second != stdQ.insert(std::make_pair(a, i)).second) return 0;
+		}
+		else if (op == 2) { if (Q.erase(a) != stdQ.erase(a)) return 0; }
+		else {
+			sjtu::btree_map<int, int>::iterator it = Q.lower_bound(a);
+			std::map<int, int>::iterator stdit = stdQ.lower_bound(a);
+			if ((it == Q.end()) != (stdit == stdQ.end())) return 0;
+			if (it != Q.end() && (it->first != stdit->first || it->second != stdit->second)) return 0;
+		}
+	}
+	const sjtu::btree_map<int, int> C(Q);
+	if (C.size() != stdQ.size()) return 0;
+	sjtu::btree_map<int, int>::const_iterator it = C.cend();
+	for (std::map<int, int>::reverse_iterator stdit = stdQ.rbegin(); stdit != stdQ.rend(); ++stdit) {
+		--it;
+		if (it->first != stdit->first || C.at(it->first) != stdit->second) return 0;
+	}
+	if (it != C.cbegin()) return 0;
+	try { --it; return 0; } catch (...) {}
+	return 1;
+}
+bool check23() {// btree_map with class keys, erase down to nothing
+	sjtu::btree_map<std::string, int> Q;
+	std::map<std::string, int> stdQ;
+	for (int i = 1; i <= 50000; i++) {
+		char buf[16];
+		sprintf(buf, "k%d", rand() % 20000);
+		Q[buf] = i; stdQ[buf] = i;
+	}
+	sjtu::btree_map<std::string, int> C;
+	C = Q;
+	while (!stdQ.empty()) {
+		std::map<std::string, int>::iterator stdit = stdQ.begin();
+		sjtu::btree_map<std::string, int>::iterator it = C.find(stdit->first);
+		if (it == C.end() || it->second != stdit->second) return 0;
+		C.erase(it);
+		stdQ.erase(stdit);
+		if (C.size() != stdQ.size()) return 0;
+	}
+	return C.empty() && C.begin() == C.end() && Q.size() != 0;
+}
+bool check24() {// flat_map && merging bulk insert
+	sjtu::flat_map<int, int> Q;
+	std::map<int, int> stdQ;
+	for (int round = 1; round <= 50; round++) {
+		std::vector<std::pair<int, int> > batch;
+		for (int i = 1; i <= 2000; i++)
+			batch.push_back(std::make_pair(rand() % 100000, rand()));
+		Q.insert(batch.begin(), batch.end());
+		for (size_t i = 0; i < batch.size(); i++)
+			stdQ.insert(batch[i]);
+		for (int i = 1; i <= 100; i++) {
+			int a = rand() % 100000;
+			if (Q.erase(a) != stdQ.erase(a)) return 0;
+			a = rand() % 100000;
+			Q[a] = i; stdQ[a] = i;
+		}
+	}
+	const sjtu::flat_map<int, int> C(Q);
+	if (C.size() != stdQ.size()) return 0;
+	sjtu::flat_map<int, int>::const_iterator it = C.cbegin();
+	for (std::map<int, int>::iterator stdit = stdQ.begin(); stdit != stdQ.end(); ++stdit, ++it)
+		if (it->first != stdit->first || it->second != stdit->second || C.at(stdit->first) != stdit->second) return 0;
+	if (it != C.cend()) return 0;
+	for (int i = 1; i <= 1000; i++) {
+		int a = rand() % 110000;
+		std::map<int, int>::iterator stdit = stdQ.upper_bound(a);
+		sjtu::flat_map<int, int>::const_iterator cit = C.upper_bound(a);
+		if ((cit == C.cend()) != (stdit == stdQ.end())) return 0;
+		if (cit != C.cend() && cit->first != stdit->first) return 0;
+	}
+	return 1;
+}
+bool check25() {// freeze
+	sjtu::map<int, int> Q;
+	std::map<int, int> stdQ;
+	for (int i = 1; i <= 30000; i++) {
+		int a = rand() % 100000;
+		Q[a] = i; stdQ[a] = i;
+	}
+	sjtu::frozen_map<int, int> F = Q.freeze();
+	Q.clear();
+	if (F.size() != stdQ.size()) return 0;
+	sjtu::frozen_map<int, int>::const_iterator it = F.cbegin();
+	for (std::map<int, int>::iterator stdit = stdQ.begin(); stdit != stdQ.end(); ++stdit, ++it)
+		if (it->first != stdit->first || it->second != stdit->second) return 0;
+	if (it != F.cend()) return 0;
+	for (int i = 1; i <= 30000; i++) {
+		int a = rand() % 110000 - 5000;
+		std::map<int, int>::iterator stdit = stdQ.lower_bound(a);
+		it = F.lower_bound(a);
+		if ((it == F.cend()) != (stdit == stdQ.end())) return 0;
+		if (it != F.cend() && it->first != stdit->first) return 0;
+		stdit = stdQ.upper_bound(a);
+		it = F.upper_bound(a);
+		if ((it == F.cend()) != (stdit == stdQ.end())) return 0;
+		if (it != F.cend() && it->first != stdit->first) return 0;
+		if (F.count(a) != stdQ.count(a)) return 0;
+	}
+	sjtu::map<int, int, std::greater<int> > R;// the frozen copy orders by the map's comparator
+	for (int i = 1; i <= 1000; i++) R[i] = -i;
+	sjtu::frozen_map<int, int, std::greater<int> > G = R.freeze();
+	if (G.cbegin()->first != 1000 || G.at(500) != -500 || G.lower_bound(0) != G.cend()) return 0;
+	return 1;
+}
+bool check26() {// concurrent_map through one thread, iterating across shards
+	sjtu::concurrent_map<int, int> Q(sjtu::concurrent_map<int, int>::even_splits(0, 100000, 16));
+	std::map<int, int> stdQ;
+	for (int i = 1; i <= 50000; i++) {
+		int a = rand() % 100000, op = rand() % 4;
+		if (op == 0) { Q.insert(sjtu::pair<const int, int>(a, i)); stdQ.insert(std::make_pair(a, i)); }
+		else if (op == 1) { Q.insert_or_assign(a, i); stdQ[a] = i; }
+		else if (op == 2) { if (Q.erase(a) != stdQ.erase(a)) return 0; }
+		else {
+			int v = 0;
+			if (Q.find(a, v) != (stdQ.count(a) == 1)) return 0;
+			if (stdQ.count(a) && (v != stdQ[a] || Q.at(a) != v)) return 0;
+		}
+	}
+	if (Q.size() != stdQ.size()) return 0;
+	sjtu::concurrent_map<int, int>::const_iterator it = Q.begin();
+	for (std::map<int, int>::iterator stdit = stdQ.begin(); stdit != stdQ.end(); ++stdit, ++it)
+		if (it == Q.end() || it->first != stdit->first || it->second != stdit->second) return 0;
+	if (it != Q.end()) return 0;
+	it = Q.lower_bound(31234);
+	if (it->first != stdQ.lower_bound(31234)->first) return 0;
+	try { Q.at(-1); return 0; } catch (...) {}
+	return 1;
+}
+bool check27() {// concurrent_skiplist_map through one thread
+	sjtu::concurrent_skiplist_map<int, int> Q;
+	std::map<int, int> stdQ;
+	for (int i = 1; i <= 50000; i++) {
+		int a = rand() % 10000, op = rand() % 3;
+		if (op == 0) { if (Q.insert(sjtu::pair<const int, int>(a, i)) != stdQ.insert(std::make_pair(a, i)).second) return 0; }
+		else if (op == 1) { if (Q.erase(a) != stdQ.erase(a)) return 0; }
+		else {
+			if (Q.count(a) != stdQ.count(a)) return 0;
+			if (stdQ.count(a) && (Q.at(a) != stdQ[a] || Q.find(a)->second != stdQ[a])) return 0;
+			sjtu::concurrent_skiplist_map<int, int>::const_iterator it = Q.upper_bound(a);
+			std::map<int, int>::iterator stdit = stdQ.upper_bound(a);
+			if ((it == Q.end()) != (stdit == stdQ.end())) return 0;
+			if (it != Q.end() && it->first != stdit->first) return 0;
+		}
+	}
+	if (Q.size() != stdQ.size()) return 0;
+	sjtu::concurrent_skiplist_map<int, int>::const_iterator it = Q.begin();
+	for (std::map<int, int>::iterator stdit = stdQ.begin(); stdit != stdQ.end(); ++stdit, ++it)
+		if (it == Q.end() || it->first != stdit->first || it->second != stdit->second) return 0;
+	if (it != Q.end()) return 0;
+	try { Q.at(-1); return 0; } catch (...) {}
+	Q.clear();
+	if (!Q.empty() || Q.size() != 0) return 0;
+	return 1;
+}
+bool check28() {// persistent_map snapshots keep their contents while the map changes
+	sjtu::persistent_map<int, int> Q;
+	std::map<int, int> stdQ;
+	std::vector<sjtu::persistent_map<int, int> > snaps;
+	std::vector<std::map<int, int> > stdSnaps;
+	for (int i = 1; i <= 50000; i++) {
+		int a = rand() % 10000, op = rand() % 3;
+		if (op == 0) { if (Q.insert(sjtu::pair<const int, int>(a, i)) != stdQ.insert(std::make_pair(a, i)).second) return 0; }
+		else if (op == 1) { bool fresh = !stdQ.count(a); stdQ[a] = i; if (Q.insert_or_assign(a, i) != fresh) return 0; }
+		else if (Q.erase(a) != stdQ.erase(a)) return 0;
+		if (i % 10000 == 0) { snaps.push_back(Q.snapshot()); stdSnaps.push_back(stdQ); }
+	}
+	snaps.push_back(Q);
+	stdSnaps.push_back(stdQ);
+	Q.clear();
+	for (size_t j = 0; j < snaps.size(); j++) {
+		if (snaps[j].size() != stdSnaps[j].size()) return 0;
+		sjtu::persistent_map<int, int>::const_iterator it = snaps[j].begin();
+		for (std::map<int, int>::iterator stdit = stdSnaps[j].begin(); stdit != stdSnaps[j].end(); ++stdit, ++it)
+			if (it == snaps[j].end() || it->first != stdit->first || it->second != stdit->second) return 0;
+		if (it != snaps[j].end()) return 0;
+		it = snaps[j].upper_bound(5000);
+		if (it == snaps[j].end() || it->first != stdSnaps[j].upper_bound(5000)->first) return 0;
+		--it;
+		if (it->first != (--stdSnaps[j].upper_bound(5000))->first || snaps[j].at(it->first) != it->second) return 0;
+	}
+	try { snaps[0].at(-1); return 0; } catch (...) {}
+	if (!Q.empty()) return 0;
+	// snapshots of one base changed on separate threads
+	for (int i = 0; i < 20000; i++) Q.insert_or_assign(i, i);
+	sjtu::persistent_map<int, int> base = Q.snapshot();
+	std::vector<sjtu::persistent_map<int, int> > copies(4, base);
+	std::vector<std::thread> threads;
+	for (int j = 0; j < 4; j++)
+		threads.push_back(std::thread([&copies, j]() {
+			unsigned x = j * 7919 + 1;
+			for (int i = 0; i < 15000; i++) {
+				x = x * 1103515245 + 12345;
+				copies[j].erase((x >> 8) % 20000);
+			}
+			for (int k = 0; k < 20000; k += 7) copies[j].insert_or_assign(k, -j);
+		}));
+	for (int j = 0; j < 4; j++) threads[j].join();
+	for (int j = 0; j < 4; j++) {
+		std::map<int, int> expect;
+		for (int i = 0; i < 20000; i++) expect[i] = i;
+		unsigned x = j * 7919 + 1;
+		for (int i = 0; i < 15000; i++) {
+			x = x * 1103515245 + 12345;
+			expect.erase((x >> 8) % 20000);
+		}
+		for (int k = 0; k < 20000; k += 7) expect[k] = -j;
+		if (copies[j].size() != expect.size()) return 0;
+		sjtu::persistent_map<int, int>::const_iterator it = copies[j].begin();
+		for (std::map<int, int>::iterator stdit = expect.begin(); stdit != expect.end(); ++stdit, ++it)
+			if (it->first != stdit->first || it->second != stdit->second) return 0;
+	}
+	for (int i = 0; i < 20000; i++)
+		if (base.at(i) != i || Q.at(i) != i) return 0;
+	return base.size() == 20000;
+}
+bool check29() {// split, join, merge and the set operations move nodes between maps
+	typedef sjtu::map<int, int, std::less<int>, sjtu::order_statistic> OSMap;
+	OSMap A, B;
+	std::map<int, int> stdA, stdB;
+	for (int i = 1; i <= 20000; i++) {
+		int a = rand() % 30000, b = rand() % 30000;
+		A[a] = i; stdA[a] = i;
+		B[b] = -i; stdB[b] = -i;
+	}
+	OSMap::iterator kept = A.find(stdA.rbegin()->first);
+	OSMap C = A.split(15000);
+	std::map<int, int> stdC(stdA.lower_bound(15000), stdA.end());
+	stdA.erase(stdA.lower_bound(15000), stdA.end());
+	if (A.size() != stdA.size() || C.size() != stdC.size()) return 0;
+	if (kept != --C.end() || C.select(0)->first != stdC.begin()->first) return 0;
+	try { C.join(A); return 0; } catch (...) {}
+	A.join(C);
+	stdA.insert(stdC.begin(), stdC.end());
+	if (!C.empty() || A.size() != stdA.size()) return 0;
+	std::map<int, int> stdU(stdA), stdI, stdD;
+	for (std::map<int, int>::iterator it = stdB.begin(); it != stdB.end(); ++it) {
+		if (stdA.count(it->first)) stdI.insert(*stdA.find(it->first));
+		else stdU.insert(*it);
+	}
+	for (std::map<int, int>::iterator it = stdA.begin(); it != stdA.end(); ++it)
+		if (!stdB.count(it->first)) stdD.insert(*it);
+	OSMap I(A), D(A), M(A), MB(B);
+	I.set_intersection(B);
+	D.set_difference(B);
+	M.merge(MB);
+	A.set_union(B);
+	if (!B.empty() || A.size() != stdU.size() || M.size() != stdU.size()) return 0;
+	if (MB.size() != stdI.size() || I.size() != stdI.size() || D.size() != stdD.size()) return 0;
+	OSMap *res[] = { &A, &M, &I, &D };
+	std::map<int, int> *expect[] = { &stdU, &stdU, &stdI, &stdD };
+	for (int j = 0; j < 4; j++) {
+		OSMap::iterator it = res[j]->begin();
+		size_t k = 0;
+		for (std::map<int, int>::iterator stdit = expect[j]->begin(); stdit != expect[j]->end(); ++stdit, ++it, ++k)
+			if (it->first != stdit->first || it->second != stdit->second || res[j]->select(k) != it) return 0;
+	}
+	for (OSMap::iterator it = MB.begin(); it != MB.end(); ++it)
+		if (it->second >= 0 || !stdI.count(it->first)) return 0;
+	// maps sharing a node pool after a merge are changed on two threads
+	OSMap *both[] = { &M, &MB };
+	std::map<int, int> stdBoth[] = { stdU, std::map<int, int>() };
+	for (OSMap::iterator it = MB.begin(); it != MB.end(); ++it) stdBoth[1][it->first] = it->second;
+	std::vector<std::thread> threads;
+	for (int j = 0; j < 2; j++)
+		threads.push_back(std::thread([&both, &stdBoth, j]() {
+			unsigned x = j + 1;
+			for (int i = 0; i < 20000; i++) {
+				x = x * 1103515245 + 12345;
+				int a = (x >> 8) % 30000;
+				if (x & 1) { (*both[j])[a] = i; stdBoth[j][a] = i; }
+				else { both[j]->erase(a); stdBoth[j].erase(a); }
+			}
+		}));
+	for (int j = 0; j < 2; j++) threads[j].join();
+	for (int j = 0; j < 2; j++) {
+		if (both[j]->size() != stdBoth[j].size()) return 0;
+		OSMap::iterator it = both[j]->begin();
+		for (std::map<int, int>::iterator stdit = stdBoth[j].begin(); stdit != stdBoth[j].end(); ++stdit, ++it)
+			if (it->first != stdit->first || it->second != stdit->second) return 0;
+	}
+	return 1;
+}
+bool check30() {// parallel_insert and parallel_union agree with inserting one by one
+	typedef sjtu::map<int, int, std::less<int>, sjtu::order_statistic> OSMap;
+	sjtu::vector<sjtu::pair<int, int> > in;
+	OSMap A, B;
+	std::map<int, int> stdA, stdB;
+	for (int i = 1; i <= 20000; i++) {
+		int a = rand() % 50000, b = rand() % 50000;
+		A[a] = i; stdA[a] = i;
+		in.push_back(sjtu::pair<int, int>(b, -i)); stdB.insert(std::make_pair(b, -i));
+	}
+	OSMap C(A);
+	std::map<int, int> stdC(stdA);
+	stdC.insert(stdB.begin(), stdB.end());
+	A.parallel_insert(in.begin(), in.end(), 3);
+	B.parallel_insert(in.begin(), in.end());
+	C.parallel_union(B, 4);
+	if (!B.empty() || A.size() != stdC.size() || C.size() != stdC.size()) return 0;
+	OSMap::iterator it = A.begin(), cit = C.begin();
+	size_t k = 0;
+	for (std::map<int, int>::iterator stdit = stdC.begin(); stdit != stdC.end(); ++stdit, ++it, ++cit, ++k)
+		if (it->first != stdit->first || it->second != stdit->second || cit->first != stdit->first || cit->second != stdit->second || A.select(k) != it) return 0;
+	return 1;
+}
+bool check31() {// apply_batch agrees with applying the operations one by one
+	typedef sjtu::map<int, int, std::less<int>, sjtu::order_statistic> OSMap;
+	OSMap Q;
+	std::map<int, int> stdQ;
+	for (int i = 1; i <= 10000; i++) {
+		int a = rand() % 20000;
+		Q[a] = i; stdQ[a] = i;
+	}
+	sjtu::vector<OSMap::batch_op> ops;
+	std::vector<bool> expect;
+	for (int i = 1; i <= 20000; i++) {
+		int a = rand() % 20000;
+		if (rand() % 3 == 0) {
+			ops.push_back(OSMap::batch_op::erase(a));
+			expect.push_back(stdQ.erase(a) > 0);
+		}
+		else {
+			ops.push_back(OSMap::batch_op::upsert(a, -i));
+			expect.push_back(stdQ.count(a) == 0);
+			stdQ[a] = -i;
+		}
+	}
+	Q.apply_batch(ops);
+	for (size_t i = 0; i < ops.size(); i++)
+		if (ops[i].result != expect[i]) return 0;
+	if (Q.size() != stdQ.size()) return 0;
+	OSMap::iterator it = Q.begin();
+	size_t k = 0;
+	for (std::map<int, int>::iterator stdit = stdQ.begin(); stdit != stdQ.end(); ++stdit, ++it, ++k)
+		if (it->first != stdit->first || it->second != stdit->second || Q.select(k) != it) return 0;
+	// upserts of keys already there keep the aggregate right
+	typedef sjtu::map<int, int, std::less<int>, sjtu::aggregate<bytes_sum> > summed;
+	summed S;
+	std::map<int, int> stdS;
+	for (int i = 1; i <= 10000; i++) {
+		int a = rand() % 5000;
+		S.insert_or_assign(a, i); stdS[a] = i;
+	}
+	sjtu::vector<summed::batch_op> sops;
+	for (int i = 1; i <= 3000; i++) {
+		int a = rand() % 5000;
+		sops.push_back(summed::batch_op::upsert(a, rand() % 1000));
+		stdS[a] = sops.back().value;
+	}
+	S.apply_batch(sops);
+	for (int i = 1; i <= 300; i++) {
+		int lo = rand() % 5500 - 250, hi = lo + rand() % 2000;
+		long long sum = 0;
+		for (std::map<int, int>::iterator stdit = stdS.lower_bound(lo); stdit != stdS.end() && stdit->first < hi; ++stdit)
+			sum += stdit->second;
+		if (S.range_reduce(lo, hi) != sum) return 0;
+	}
+	return 1;
+}
+bool check32() {// erase returns the next element, erase(first, last) cuts out a range
+	typedef sjtu::map<int, int, std::less<int>, sjtu::order_statistic> OSMap;
+	OSMap Q;
+	std::map<int, int> stdQ;
+	for (int i = 1; i <= 20000; i++) {
+		int a = rand() % 30000;
+		Q[a] = i; stdQ[a] = i;
+	}
+	for (int i = 1; i <= 200; i++) {
+		int a = rand() % 30000;
+		OSMap::iterator it = Q.lower_bound(a);
+		std::map<int, int>::iterator stdit = stdQ.lower_bound(a);
+		if (it == Q.end()) continue;
+		it = Q.erase(it); stdit = stdQ.erase(stdit);
+		if ((it == Q.end()) != (stdit == stdQ.end()) || (it != Q.end() && it->first != stdit->first)) return 0;
+	}
+	for (int i = 1; i <= 50; i++) {
+		int a = rand() % 30000, b = a + rand() % (i % 2 ? 20 : 5000);
+		OSMap::iterator last = Q.lower_bound(b);
+		if (Q.erase(Q.lower_bound(a), last) != last) return 0;
+		stdQ.erase(stdQ.lower_bound(a), stdQ.lower_bound(b));
+	}
+	try { Q.erase(--Q.end(), Q.begin()); return 0; } catch (...) {}
+	OSMap Q2(Q);
+	try { Q.erase(Q2.begin(), Q.end()); return 0; } catch (...) {}
+	if (Q.size() != stdQ.size()) return 0;
+	OSMap::iterator it = Q.begin();
+	size_t k = 0;
+	for (std::map<int, int>::iterator stdit = stdQ.begin(); stdit != stdQ.end(); ++stdit, ++it, ++k)
+		if (it->first != stdit->first || it->second != stdit->second || Q.select(k) != it) return 0;
+	Q.erase(Q.begin(), Q.end());
+	return Q.empty() && Q.begin() == Q.end();
+}
+bool check33() {// extract and insert move nodes between maps, handles outlive their map, emptied maps stop sharing
+	typedef sjtu::map<int, string> SMap;
+	SMap *hot = new SMap, cold;
+	std::map<int, string> stdHot, stdCold;
+	for (int i = 1; i <= 5000; i++) {
+		int a = rand() % 10000, b = rand() % 10000;
+		(*hot)[a] = "h" + to_string(i); stdHot[a] = "h" + to_string(i);
+		cold[b] = "c" + to_string(i); stdCold[b] = "c" + to_string(i);
+	}
+	for (int i = 1; i <= 5000; i++) {
+		int a = rand() % 10000;
+		SMap::node_type nh = hot->extract(a);
+		if (nh.empty() != (stdHot.count(a) == 0)) return 0;
+		if (nh.empty()) continue;
+		if (nh.key() != a || nh.mapped() != stdHot[a]) return 0;
+		bool fresh = stdCold.count(a) == 0;
+		sjtu::pair<SMap::iterator, bool> res = cold.insert(std::move(nh));
+		if (res.second != fresh || res.first->first != a || nh.empty() != fresh) return 0;
+		if (fresh) stdCold[a] = stdHot[a];
+		else hot->insert(std::move(nh));
+		if (fresh) stdHot.erase(a);
+	}
+	SMap::node_type first = hot->extract(hot->begin());
+	string value = first.mapped();
+	int key = first.key();
+	stdHot.erase(key);
+	if (hot->size() != stdHot.size()) return 0;
+	delete hot;
+	try { SMap::node_type none; none.key(); return 0; } catch (...) {}
+	if (cold.insert(std::move(first)).second) stdCold[key] = value;
+	if (cold.size() != stdCold.size()) return 0;
+	SMap::iterator it = cold.begin();
+	for (std::map<int, string>::iterator stdit = stdCold.begin(); stdit != stdCold.end(); ++stdit, ++it)
+		if (it->first != stdit->first || it->second != stdit->second) return 0;
+	// maps share a pool only while both hold nodes, an emptied one goes back to allocating alone
+	SMap A, B;
+	for (int i = 1; i <= 100; i++) { A[i] = "a"; B[-i] = "b"; }
+	if (A.shares_pool() || B.shares_pool()) return 0;
+	B.merge(A);
+	if (!A.empty() || A.shares_pool() || B.shares_pool()) return 0;
+	A[1] = "a";
+	A.insert(B.extract(-1));
+	if (!A.shares_pool() || !B.shares_pool()) return 0;
+	B.clear();
+	if (A.shares_pool() || B.shares_pool()) return 0;
+	B.insert(A.extract(1));
+	A.erase(A.begin());
+	if (!A.empty() || A.shares_pool() || B.shares_pool() || B.size() != 1) return 0;
+	return 1;
+}
+bool check34() {// btree_map: hinted insert, emplace family, erase by iterator, transparent lookup, move
+	typedef sjtu::btree_map<int, string> BMap;
+	BMap Q;
+	std::map<int, string> stdQ;
+	BMap::iterator hint = Q.end();
+	for (int i = 1; i <= 20000; i++) {
+		hint = Q.insert(hint, BMap::value_type(i * 3, to_string(i)));
+		stdQ[i * 3] = to_string(i);
+	}
+	for (int i = 1; i <= 20000; i++) {
+		int a = rand() % 70000, op = rand() % 5;
+		string b = to_string(rand());
+		if (op == 0) {
+			BMap::iterator it = Q.insert(Q.lower_bound(a + rand() % 3 - 1), BMap::value_type(a, b));
+			if (!stdQ.count(a)) stdQ[a] = b;
+			if (it->first != a || it->second != stdQ[a]) return 0;
+		}
+		else if (op == 1) {
+			if (Q.emplace(a, b).second != stdQ.insert(std::make_pair(a, b)).second) return 0;
+		}
+		else if (op == 2) {
+			if (Q.try_emplace(a, 2, 'y').second != stdQ.insert(std::make_pair(a, string(2, 'y'))).second) return 0;
+		}
+		else if (op == 3) {
+			if (Q.insert_or_assign(a, b).second == (stdQ.count(a) > 0)) return 0;
+			stdQ[a] = b;
+		}
+		else {
+			BMap::iterator it = Q.lower_bound(a);
+			if (it == Q.end()) continue;
+			std::map<int, string>::iterator stdit = stdQ.erase(stdQ.find(it->first));
+			it = Q.erase(it);
+			if (stdit == stdQ.end() ? it != Q.end() : it == Q.end() || it->first != stdit->first) return 0;
+		}
+	}
+	sjtu::pair<BMap::iterator, BMap::iterator> range = Q.equal_range(stdQ.begin()->first);
+	if (range.first != Q.begin() || range.second != ++Q.begin()) return 0;
+	range = Q.equal_range(-1);
+	if (range.first != range.second || range.first != Q.begin()) return 0;
+	BMap M(std::move(Q));
+	if (!Q.empty() || Q.begin() != Q.end() || M.size() != stdQ.size()) return 0;
+	Q = std::move(M);
+	if (!M.empty() || Q.size() != stdQ.size()) return 0;
+	BMap::const_iterator it = Q.cbegin();
+	for (std::map<int, string>::iterator stdit = stdQ.begin(); stdit != stdQ.end(); ++stdit, ++it)
+		if (it->first != stdit->first || it->second != stdit->second) return 0;
+	if (it != Q.cend()) return 0;
+	std::vector<int> keys;
+	for (std::map<int, string>::iterator stdit = stdQ.begin(); stdit != stdQ.end(); ++stdit) keys.push_back(stdit->first);
+	for (size_t i = keys.size(); i > keys.size() / 2; i -= 2) {// from the back, a thinned leaf borrows from the full one before it
+		BMap::iterator pos = Q.erase(Q.find(keys[i - 1]));
+		std::map<int, string>::iterator stdit = stdQ.erase(stdQ.find(keys[i - 1]));
+		if (stdit == stdQ.end() ? pos != Q.end() : pos == Q.end() || pos->first != stdit->first) return 0;
+	}
+	std::map<int, string>::iterator stdpos = stdQ.begin();
+	for (BMap::iterator pos = Q.begin(); pos != Q.end(); ++pos, ++stdpos) {// every other one, leaves empty from inside and merge
+		pos = Q.erase(pos);
+		stdpos = stdQ.erase(stdpos);
+		if (pos == Q.end()) break;
+		if (pos->first != stdpos->first) return 0;
+	}
+	if (Q.size() != stdQ.size()) return 0;
+	size_t left = Q.size();
+	for (BMap::iterator pos = Q.begin(); pos != Q.end(); left--) pos = Q.erase(pos);
+	if (left != 0 || !Q.empty()) return 0;
+	sjtu::btree_map<label, int, label_less> L;
+	const char *names[] = { "aa", "bb", "cc", "lucky", "lwher", "zz" };
+	for (int i = 0; i < 6; i++) L.insert(sjtu::btree_map<label, int, label_less>::value_type(names[i], i));
+	label::built = 0;
+	if (L.at("lucky") != 3 || L.count("dd") != 0 || L.find("bb")->second != 1) return 0;
+	if (L.lower_bound("c")->second != 2 || L.upper_bound("lucky")->second != 4) return 0;
+	// erasing moves the labels after the gap, so built is checked before
+	if (label::built != 0) return 0;
+	if (L.erase("dd") != 0 || L.erase("cc") != 1 || L.count("cc") != 0) return 0;
+	return L.size() == 5;
+}
+typedef sjtu::map<int, int, std::less<int>, sjtu::order_statistic> ranked_map;
+bool same_ranked(const ranked_map &Q, const std::map<int, int> &stdQ) {
+	if (Q.size() != stdQ.size()) return 0;
+	ranked_map::const_iterator it = Q.cbegin();
+	size_t n = 0;
+	for (std::map<int, int>::const_iterator stdit = stdQ.begin(); stdit != stdQ.end(); ++stdit, ++it, ++n)
+		if (it->first != stdit->first || it->second != stdit->second || Q.rank(it->first) != n) return 0;
+	return it == Q.cend();
+}
+class fragile {
+public:
+	static int budget;// copies left before one throws, negative for no limit
+	int v;
+	fragile(int v = 0) : v(v) {}
+	fragile(const fragile &other) : v(other.v) {
+		if (budget == 0) throw sjtu::runtime_error();
+		if (budget > 0) budget--;
+	}
+	fragile & operator=(const fragile &other) { v = other.v; return *this; }
+};
+int fragile::budget = -1;
+bool check35() {// copying into a non-empty map reuses its nodes, a throwing copy leaves it empty
+	ranked_map big, small;
+	std::map<int, int> stdBig, stdSmall;
+	for (int i = 1; i <= 100000; i++) {
+		int a = rand() % 200000;
+		big[a] = i; stdBig[a] = i;
+	}
+	for (int i = 1; i <= 3000; i++) {
+		int a = rand() % 200000;
+		small[a] = -i; stdSmall[a] = -i;
+	}
+	ranked_map D(small);
+	if (!same_ranked(D, stdSmall)) return 0;
+	D = big;
+	if (!same_ranked(D, stdBig) || !same_ranked(big, stdBig)) return 0;
+	D = small;
+	std::map<int, int> stdD(stdSmall);
+	if (!same_ranked(D, stdD)) return 0;
+	for (int i = 1; i <= 20000; i++) {
+		int a = rand() % 200000;
+		if (i & 1) { D[a] = i; stdD[a] = i; }
+		else { D.erase(a); stdD.erase(a); }
+	}
+	if (!same_ranked(D, stdD) || !same_ranked(small, stdSmall)) return 0;
+	sjtu::map<int, fragile> F, G;
+	for (int i = 1; i <= 5000; i++) F[i] = fragile(i);
+	for (int i = 1; i <= 100; i++) G[-i] = fragile(i);
+	fragile::budget = 50;// while G's own nodes are being reused
+	try { G = F; fragile::budget = -1; return 0; } catch (...) {}
+	if (!G.empty()) return 0;
+	fragile::budget = -1;
+	for (int i = 1; i <= 100; i++) G[-i] = fragile(i);
+	fragile::budget = 2500;// once they have run out
+	try { G = F; fragile::budget = -1; return 0; } catch (...) {}
+	fragile::budget = 10;
+	try { sjtu::map<int, fragile> H(F); fragile::budget = -1; return 0; } catch (...) {}
+	fragile::budget = -1;
+	if (!G.empty() || G.size() != 0 || G.begin() != G.end() || G.find(-1) != G.end()) return 0;
+	G[7] = fragile(-7);
+	if (G.size() != 1 || G.at(7).v != -7) return 0;
+	G = F;
+	if (G.size() != F.size()) return 0;
+	sjtu::map<int, fragile>::iterator it = G.begin();
+	for (int i = 1; i <= 5000; i++, ++it)
+		if (it->first != i || it->second.v != i) return 0;
+	return 1;
+}
+bool check36() {// concurrent_skiplist_map from several threads: own and shared keys, scans while erasing
+	typedef sjtu::concurrent_skiplist_map<int, int> SMap;
+	SMap Q;
+	const int OWN = 20000, SHARED = 1000, BASE = 100000;
+	std::vector<std::atomic<int> > net(SHARED);
+	for (int k = 0; k < SHARED; k++) net[k].store(0);
+	std::atomic<int> bad(0);
+	std::vector<std::thread> threads;
+	for (int j = 0; j < 4; j++)
+		threads.push_back(std::thread([&Q, &net, &bad, j]() {
+			// keys k % 4 == j are this thread's alone: all go in, those with k % 8 >= 4 come out again
+			for (int k = j; k < OWN; k += 4)
+				if (!Q.insert(SMap::value_type(k, k * 3))) bad++;
+			for (int k = j; k < OWN; k += 4)
+				if (k % 8 >= 4 && Q.erase(k) != 1) bad++;
+			// the shared keys are fought over, each success is counted
+			unsigned x = j * 7919 + 1;
+			for (int i = 0; i < 30000; i++) {
+				x = x * 1103515245 + 12345;
+				int k = (x >> 8) % SHARED;
+				if ((x >> 20) & 1) { if (Q.insert(SMap::value_type(BASE + k, (BASE + k) * 3))) net[k]++; }
+				else net[k] -= (int)Q.erase(BASE + k);
+			}
+		}));
+	for (int j = 0; j < 2; j++)
+		threads.push_back(std::thread([&Q, &bad]() {
+			// every value seen is key * 3 and the keys come in order, whatever is erased meanwhile
+			for (int round = 0; round < 20; round++) {
+				int prev = -1;
+				for (SMap::const_iterator it = Q.begin(); it != Q.end(); ++it) {
+					if (it->first <= prev || it->second != it->first * 3) bad++;
+					prev = it->first;
+				}
+				for (int k = 0; k < OWN; k += 97) {
+					SMap::const_iterator it = Q.find(k);
+					if (it != Q.end() && it->second != k * 3) bad++;
+				}
+			}
+		}));
+	for (size_t j = 0; j < threads.size(); j++) threads[j].join();
+	if (bad != 0) return 0;
+	std::map<int, int> expect;
+	for (int k = 0; k < OWN; k++)
+		if (k % 8 < 4) expect[k] = k * 3;
+	for (int k = 0; k < SHARED; k++) {
+		if (net[k] != 0 && net[k] != 1) return 0;
+		if (net[k] == 1) expect[BASE + k] = (BASE + k) * 3;
+	}
+	if (Q.size() != expect.size()) return 0;
+	SMap::const_iterator it = Q.begin();
+	for (std::map<int, int>::iterator stdit = expect.begin(); stdit != expect.end(); ++stdit, ++it)
+		if (it == Q.end() || it->first != stdit->first || it->second != stdit->second) return 0;
+	return it == Q.end();
+}
+bool check37() {// flat_map: hinted insert, emplace family, equal_range, transparent lookup, move
+	typedef sjtu::flat_map<int, string> FMap;
+	FMap Q;
+	std::map<int, string> stdQ;
+	FMap::iterator hint = Q.end();
+	for (int i = 1; i <= 3000; i++) {
+		hint = Q.insert(hint, FMap::value_type(i * 3, to_string(i)));
+		++hint;
+		stdQ[i * 3] = to_string(i);
+	}
+	for (int i = 1; i <= 6000; i++) {
+		int a = rand() % 10000, op = rand() % 6;
+		string b = to_string(rand());
+		if (op == 0) {
+			FMap::iterator it = Q.insert(Q.lower_bound(a + rand() % 3 - 1), FMap::value_type(a, b));
+			if (!stdQ.count(a)) stdQ[a] = b;
+			if (it->first != a || it->second != stdQ[a]) return 0;
+		}
+		else if (op == 1) {
+			if (Q.emplace(a, b).second != stdQ.insert(std::make_pair(a, b)).second) return 0;
+		}
+		else if (op == 2) {
+			if (Q.try_emplace(a, 2, 'y').second != stdQ.insert(std::make_pair(a, string(2, 'y'))).second) return 0;
+		}
+		else if (op == 3) {
+			if (Q.insert_or_assign(a, b).second == (stdQ.count(a) > 0)) return 0;
+			stdQ[a] = b;
+		}
+		else if (op == 4) {
+			if (Q.emplace_hint(Q.upper_bound(a), a, b)->second != stdQ.insert(std::make_pair(a, b)).first->second) return 0;
+		}
+		else {
+			FMap::iterator it = Q.lower_bound(a);
+			if (it == Q.end()) continue;
+			std::map<int, string>::iterator stdit = stdQ.erase(stdQ.find(it->first));
+			it = Q.erase(it);
+			if ((it == Q.end()) != (stdit == stdQ.end()) || (it != Q.end() && it->first != stdit->first)) return 0;
+		}
+	}
+	sjtu::pair<FMap::iterator, FMap::iterator> range = Q.equal_range(stdQ.begin()->first);
+	if (range.first != Q.begin() || range.second != ++Q.begin()) return 0;
+	range = Q.equal_range(-1);
+	if (range.first != range.second || range.first != Q.begin()) return 0;
+	FMap M(std::move(Q));
+	if (!Q.empty() || Q.begin() != Q.end() || M.size() != stdQ.size()) return 0;
+	Q = std::move(M);
+	if (!M.empty() || Q.size() != stdQ.size()) return 0;
+	FMap::const_iterator it = Q.cbegin();
+	for (std::map<int, string>::iterator stdit = stdQ.begin(); stdit != stdQ.end(); ++stdit, ++it)
+		if (it->first != stdit->first || it->second != stdit->second) return 0;
+	if (it != Q.cend()) return 0;
+	sjtu::flat_map<label, int, label_less> L;
+	const char *names[] = { "aa", "bb", "cc", "lucky", "lwher", "zz" };
+	for (int i = 0; i < 6; i++) L.insert(sjtu::flat_map<label, int, label_less>::value_type(names[i], i));
+	label::built = 0;
+	if (L.at("lucky") != 3 || L.count("dd") != 0 || L.find("bb")->second != 1) return 0;
+	if (L.lower_bound("c")->second != 2 || L.upper_bound("lucky")->second != 4) return 0;
+	// erasing moves the labels after the gap, so built is checked before
+	if (label::built != 0) return 0;
+	if (L.erase("dd") != 0 || L.erase("cc") != 1 || L.count("cc") != 0) return 0;
+	return L.size() == 5;
+}
+class flaky {
+public:
+	static int budget;// copies left before one throws, negative for no limit; only that one throws
+	int v;
+	string wide;// a key this wide fills a node with 8, so splits run up to the root
+	flaky(int v = 0) : v(v) {}
+	flaky(const flaky &other) : v(other.v) {
+		if (budget == 0) { budget = -1; throw sjtu::runtime_error(); }
+		if (budget > 0) budget--;
+	}
+	flaky & operator=(const flaky &other) { v = other.v; return *this; }
+	bool operator<(const flaky &other) const { return v < other.v; }
+};
+int flaky::budget = -1;
+bool check38() {// btree_map: a copy that throws in the middle of an insert, a leaf split or an inner split changes nothing
+	typedef sjtu::btree_map<flaky, flaky> BMap;
+	BMap Q;
+	std::map<int, int> stdQ;
+	int thrown = 0;
+	for (int i = 1; i <= 30000; i++) {
+		int a = rand() % 100000, b = rand();
+		flaky::budget = rand() % 200;
+		try {
+			Q.insert(BMap::value_type(flaky(a), flaky(b)));
+			stdQ.insert(std::map<int, int>::value_type(a, b));
+		} catch (...) { thrown++; }
+		flaky::budget = -1;
+		if (i % 3000 == 0) {
+			if (Q.size() != stdQ.size()) return 0;
+			BMap::const_iterator it = Q.cbegin();
+			for (std::map<int, int>::const_iterator stdit = stdQ.begin(); stdit != stdQ.end(); ++stdit, ++it)
+				if (it->first.v != stdit->first || it->second.v != stdit->second) return 0;
+			if (it != Q.cend()) return 0;
+		}
+	}
+	for (std::map<int, int>::const_iterator stdit = stdQ.begin(); stdit != stdQ.end(); ++stdit)
+		if (Q.count(flaky(stdit->first)) != 1 || Q.at(flaky(stdit->first)).v != stdit->second) return 0;
+	return thrown > 0;
+}
 /*bool check100(){
 sjtu::map<int, int> Q;
 Q[3] = 5;
@@ -571,5 +1572,30 @@ void easy_test() {
 //	if (!check11()) cout << "Test 11 Failed......" << endl; else cout << "Test 11 Passed!" << endl;
 //	if (!check12()) cout << "Test 12 Failed......" << endl; else cout << "Test 12 Passed!" << endl;
 //	if (!check13()) cout << "Test 13 Failed......" << endl; else cout << "Test 13 Passed!" << endl;
+//	if (!check14()) cout << "Test 14 Failed......" << endl; else cout << "Test 14 Passed!" << endl;
+//	if (!check15()) cout << "Test 15 Failed......" << endl; else cout << "Test 15 Passed!" << endl;
+//	if (!check16()) cout << "Test 16 Failed......" << endl; else cout << "Test 16 Passed!" << endl;
+//	if (!check17()) cout << "Test 17 Failed......" << endl; else cout << "Test 17 Passed!" << endl;
+//	if (!check18()) cout << "Test 18 Failed......" << endl; else cout << "Test 18 Passed!" << endl;
+//	if (!check19()) cout << "Test 19 Failed......" << endl; else cout << "Test 19 Passed!" << endl;
+//	if (!check20()) cout << "Test 20 Failed......" << endl; else cout << "Test 20 Passed!" << endl;
+//	if (!check21()) cout << "Test 21 Failed......" << endl; else cout << "Test 21 Passed!" << endl;
+//	if (!check22()) cout << "Test 22 Failed......" << endl; else cout << "Test 22 Passed!" << endl;
+//	if (!check23()) cout << "Test 23 Failed......" << endl; else cout << "Test 23 Passed!" << endl;
+//	if (!check24()) cout << "Test 24 Failed......" << endl; else cout << "Test 24 Passed!" << endl;
+//	if (!check25()) cout << "Test 25 Failed......" << endl; else cout << "Test 25 Passed!" << endl;
+//	if (!check26()) cout << "Test 26 Failed......" << endl; else cout << "Test 26 Passed!" << endl;
+//	if (!check27()) cout << "Test 27 Failed......" << endl; else cout << "Test 27 Passed!" << endl;
+//	if (!check28()) cout << "Test 28 Failed......" << endl; else cout << "Test 28 Passed!" << endl;
+//	if (!check29()) cout << "Test 29 Failed......" << endl; else cout << "Test 29 Passed!" << endl;
+//	if (!check30()) cout << "Test 30 Failed......" << endl; else cout << "Test 30 Passed!" << endl;
+//	if (!check31()) cout << "Test 31 Failed......" << endl; else cout << "Test 31 Passed!" << endl;
+//	if (!check32()) cout << "Test 32 Failed......" << endl; else cout << "Test 32 Passed!" << endl;
+//	if (!check33()) cout << "Test 33 Failed......" << endl; else cout << "Test 33 Passed!" << endl;
+//	if (!check34()) cout << "Test 34 Failed......" << endl; else cout << "Test 34 Passed!" << endl;
+//	if (!check35()) cout << "Test 35 Failed......" << endl; else cout << "Test 35 Passed!" << endl;
+//	if (!check36()) cout << "Test 36 Failed......" << endl; else cout << "Test 36 Passed!" << endl;
+//	if (!check37()) cout << "Test 37 Failed......" << endl; else cout << "Test 37 Passed!" << endl;
+//	if (!check38()) cout << "Test 38 Failed......" << endl; else cout << "Test 38 Passed!" << endl;
 //	return 0;
 //}
@@ -0,0 +1,590 @@
+/**
+* benchmarks for the containers; build with -O2 -pthread.
+*/
+#include "map.hpp"
+#include "btree.hpp"
+#include "concurrent-map.hpp"
+#include "skiplist-map.hpp"
+#include "persistent-map.hpp"
+#include "vector.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+/**
+* wall time of f() in milliseconds.
+*/
+template<class F>
+double TimeMs(F f)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+* memory per element for both node layouts (see packed_links / plain_links).
+*/
+template<class Key, class T>
+void LayoutReport(const char *name)
+{
+	typedef sjtu::pair<const Key, T> value_type;
+	typedef sjtu::rb_node<sjtu::plain_links, value_type> PlainNode;
+	typedef sjtu::rb_node<sjtu::packed_links, value_type> PackedNode;
+	size_t plain = sjtu::slab_pool<sizeof(PlainNode), alignof(PlainNode)>::block_size();
+	size_t packed = sjtu::slab_pool<sizeof(PackedNode), alignof(PackedNode)>::block_size();
+	std::cout << std::left << std::setw(26) << name << std::right
+		<< " value " << std::setw(3) << sizeof(value_type)
+		<< "  plain " << std::setw(3) << plain
+		<< "  packed " << std::setw(3) << packed
+		<< "  in use " << std::setw(3) << sjtu::map<Key, T>::node_bytes()
+		<< "  saving " << std::fixed << std::setprecision(1) << 100.0 * (plain - packed) / plain << "%" << std::endl;
+}
+
+void TestLayout()
+{
+	std::cout << "Bytes per entry..." << std::endl;
+	LayoutReport<int, int>("map<int, int>");
+	LayoutReport<int, long long>("map<int, long long>");
+	LayoutReport<long long, long long>("map<long long, long long>");
+	LayoutReport<int, double>("map<int, double>");
+	LayoutReport<std::string, int>("map<string, int>");
+}
+
+/**
+* plain insert against hinted insert for sorted and near-sorted keys.
+*/
+void HintReport(const char *name, const std::vector<int> &keys)
+{
+	typedef sjtu::map<int, int> Map;
+	size_t n = 0;
+	double plain = TimeMs([&]() {
+		Map Q;
+		for (size_t i = 0; i < keys.size(); i++)
+			Q.insert(Map::value_type(keys[i], i));
+		n = Q.size();
+	});
+	double atEnd = TimeMs([&]() {
+		Map Q;
+		for (size_t i = 0; i < keys.size(); i++)
+			Q.insert(Q.cend(), Map::value_type(keys[i], i));
+	});
+	double atLast = TimeMs([&]() {
+		Map Q;
+		Map::iterator hint = Q.end();
+		for (size_t i = 0; i < keys.size(); i++)
+			hint = Q.insert(hint, Map::value_type(keys[i], i));
+	});
+	std::cout << std::left << std::setw(14) << name << std::right << std::fixed << std::setprecision(1)
+		<< " n " << n
+		<< "  insert " << std::setw(7) << plain << " ms"
+		<< "  hint end() " << std::setw(7) << atEnd << " ms"
+		<< "  hint last " << std::setw(7) << atLast << " ms" << std::endl;
+}
+
+void TestHintedInsert()
+{
+	std::cout << "Hinted insert..." << std::endl;
+	const int n = 2000000;
+	std::vector<int> keys(n);
+	for (int i = 0; i < n; i++)
+		keys[i] = i * 2;
+	HintReport("sorted", keys);
+	// every key is at most a few slots away from its sorted place
+	for (int i = 0; i + 1 < n; i += 1 + rand() % 4)
+		std::swap(keys[i], keys[i + 1 + rand() % std::min(4, n - i - 1)]);
+	HintReport("near-sorted", keys);
+	std::shuffle(keys.begin(), keys.end(), std::mt19937(325));
+	HintReport("random", keys);
+}
+
+/**
+* the red-black tree against the B+ tree on n random keys:
+*   insert, successful and failed find, a full scan and erasing half.
+*/
+template<class Map>
+void EngineReport(const char *name, const std::vector<int> &keys, const std::vector<int> &probes)
+{
+	Map *Q = new Map();
+	long long sum = 0;
+	double insert = TimeMs([&]() {
+		for (size_t i = 0; i < keys.size(); i++)
+			(*Q)[keys[i]] = i;
+	});
+	double find = TimeMs([&]() {
+		for (size_t i = 0; i < probes.size(); i++)
+			sum += Q->count(probes[i]);
+	});
+	double scan = TimeMs([&]() {
+		for (typename Map::const_iterator it = Q->cbegin(); it != Q->cend(); ++it)
+			sum += it->second;
+	});
+	double erase = TimeMs([&]() {
+		for (size_t i = 0; i < keys.size(); i += 2)
+			Q->erase(keys[i]);
+	});
+	double destroy = TimeMs([&]() {
+		delete Q;
+	});
+	std::cout << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(1)
+		<< " insert " << std::setw(8) << insert << " ms"
+		<< "  find " << std::setw(8) << find << " ms"
+		<< "  scan " << std::setw(7) << scan << " ms"
+		<< "  erase half " << std::setw(8) << erase << " ms"
+		<< "  clear " << std::setw(6) << destroy << " ms"
+		<< "  (" << sum % 10 << ")" << std::endl;
+}
+
+void TestEngines(size_t maxN)
+{
+	std::cout << "Red-black tree against B+ tree..." << std::endl;
+	for (size_t n = 1000000; n <= maxN; n *= 10)
+	{
+		std::mt19937 gen(n);
+		std::vector<int> keys(n), probes(n);
+		for (size_t i = 0; i < n; i++)
+			keys[i] = static_cast<int>(gen() & 0x7fffffff);
+		// half of the probes hit
+		for (size_t i = 0; i < n; i++)
+			probes[i] = i % 2 ? keys[gen() % n] : static_cast<int>(gen() & 0x7fffffff);
+		std::cout << "n = " << n << std::endl;
+		EngineReport<sjtu::map<int, int> >("map", keys, probes);
+		EngineReport<sjtu::btree_map<int, int> >("btree_map", keys, probes);
+	}
+}
+
+/**
+* lookups in a map against lookups in its frozen copy.
+*/
+void TestFrozen()
+{
+	std::cout << "Frozen lookups..." << std::endl;
+	for (size_t n = 1000; n <= 10000000; n *= 100)
+	{
+		std::mt19937 gen(n);
+		sjtu::map<int, int> Q;
+		while (Q.size() < n)
+			Q[static_cast<int>(gen() & 0x7fffffff)] = 1;
+		sjtu::frozen_map<int, int> F = Q.freeze();
+		std::vector<int> probes(10000000);
+		for (size_t i = 0; i < probes.size(); i++)
+			probes[i] = static_cast<int>(gen() & 0x7fffffff);
+		long long sum = 0;
+		double tree = TimeMs([&]() {
+			for (size_t i = 0; i < probes.size(); i++)
+				sum += Q.lower_bound(probes[i]) != Q.end();
+		});
+		double frozen = TimeMs([&]() {
+			for (size_t i = 0; i < probes.size(); i++)
+				sum += F.lower_bound(probes[i]) != F.end();
+		});
+		std::cout << "n " << std::setw(8) << n << std::fixed << std::setprecision(1)
+			<< "  map::lower_bound " << std::setw(7) << tree << " ms"
+			<< "  frozen_map::lower_bound " << std::setw(7) << frozen << " ms"
+			<< "  (" << sum % 10 << ")" << std::endl;
+	}
+}
+
+/**
+* throughput of threads doing a mix of lookups and inserts/erases on
+*   random keys: one map behind one mutex against the sharded map.
+*/
+template<class Op>
+double Throughput(int threads, int opsPerThread, Op op)
+{
+	std::vector<std::thread> pool;
+	std::atomic<long long> sink(0);
+	double ms = TimeMs([&]() {
+		for (int t = 0; t < threads; t++)
+			pool.push_back(std::thread([&, t]() {
+				std::mt19937 gen(t);
+				long long sum = 0;
+				for (int i = 0; i < opsPerThread; i++)
+					sum += op(gen);
+				sink += sum;
+			}));
+		for (size_t t = 0; t < pool.size(); t++)
+			pool[t].join();
+	});
+	if (sink < 0)
+		std::cout << sink << std::endl;
+	return threads * (double)opsPerThread / ms / 1000.0;
+}
+
+void TestConcurrent()
+{
+	std::cout << "Concurrent throughput (Mops/s), " << std::thread::hardware_concurrency() << " hardware threads..." << std::endl;
+	const int keys = 1000000, ops = 200000;
+	const int reads[] = { 100, 95, 50 };
+	for (int r = 0; r < 3; r++)
+	{
+		for (int threads = 1; threads <= 8; threads *= 2)
+		{
+			sjtu::map<int, int> Q;
+			std::mutex lock;
+			sjtu::concurrent_map<int, int> C(sjtu::concurrent_map<int, int>::even_splits(0, keys, 64));
+			for (int i = 0; i < keys; i += 2)
+			{
+				Q[i] = i;
+				C.insert_or_assign(i, i);
+			}
+			int readPct = reads[r];
+			double global = Throughput(threads, ops, [&](std::mt19937 &gen) {
+				int k = gen() % keys;
+				std::lock_guard<std::mutex> g(lock);
+				if ((int)(gen() % 100) < readPct)
+					return Q.count(k);
+				else if (k & 1)
+					Q[k] = k;
+				else
+					Q.erase(k);
+				return (size_t)0;
+			});
+			double sharded = Throughput(threads, ops, [&](std::mt19937 &gen) {
+				int k = gen() % keys;
+				if ((int)(gen() % 100) < readPct)
+					return C.count(k);
+				else if (k & 1)
+					C.insert_or_assign(k, k);
+				else
+					C.erase(k);
+				return (size_t)0;
+			});
+			std::cout << std::setw(3) << readPct << "% reads  " << threads << " threads" << std::fixed << std::setprecision(2)
+				<< "  one mutex " << std::setw(6) << global
+				<< "  64 shards " << std::setw(6) << sharded << std::endl;
+		}
+	}
+}
+
+/**
+* write-heavy ingest, 80% inserts and 20% erases on random keys, with a
+*   lookup-only run after it: one map behind one mutex against the lock-free
+*   skiplist.
+*/
+void TestSkiplist()
+{
+	std::cout << "Skiplist throughput (Mops/s), " << std::thread::hardware_concurrency() << " hardware threads..." << std::endl;
+	const int keys = 1000000, ops = 200000;
+	for (int threads = 1; threads <= 8; threads *= 2)
+	{
+		sjtu::map<int, int> Q;
+		std::mutex lock;
+		sjtu::concurrent_skiplist_map<int, int> S;
+		double global = Throughput(threads, ops, [&](std::mt19937 &gen) {
+			int k = gen() % keys;
+			std::lock_guard<std::mutex> g(lock);
+			if (gen() % 5 != 0)
+				return (size_t)Q.insert(sjtu::pair<const int, int>(k, k)).second;
+			return Q.erase(k);
+		});
+		double lockFree = Throughput(threads, ops, [&](std::mt19937 &gen) {
+			int k = gen() % keys;
+			if (gen() % 5 != 0)
+				return (size_t)S.insert(sjtu::pair<const int, int>(k, k));
+			return S.erase(k);
+		});
+		double globalFind = Throughput(threads, ops, [&](std::mt19937 &gen) {
+			int k = gen() % keys;
+			std::lock_guard<std::mutex> g(lock);
+			return Q.count(k);
+		});
+		double lockFreeFind = Throughput(threads, ops, [&](std::mt19937 &gen) {
+			return S.count(gen() % keys);
+		});
+		std::cout << threads << " threads" << std::fixed << std::setprecision(2)
+			<< "  ingest: one mutex " << std::setw(6) << global << "  skiplist " << std::setw(6) << lockFree
+			<< "  find: one mutex " << std::setw(6) << globalFind << "  skiplist " << std::setw(6) << lockFreeFind << std::endl;
+	}
+}
+
+/**
+* taking a consistent copy of a large map: a deep map copy against a
+*   persistent_map snapshot, and what the writes after a snapshot cost.
+*/
+void TestSnapshot()
+{
+	std::cout << "Snapshots..." << std::endl;
+	for (size_t n = 100000; n <= 10000000; n *= 10)
+	{
+		std::mt19937 gen(n);
+		sjtu::map<int, int> Q;
+		sjtu::persistent_map<int, int> P;
+		std::vector<int> keys;
+		while (Q.size() < n)
+		{
+			int k = static_cast<int>(gen() & 0x7fffffff);
+			if (Q.insert(sjtu::pair<const int, int>(k, 1)).second)
+			{
+				P.insert(sjtu::pair<const int, int>(k, 1));
+				keys.push_back(k);
+			}
+		}
+		const size_t writes = 100000;
+		double copy = TimeMs([&]() {
+			sjtu::map<int, int> C(Q);
+		});
+		double mapWrites = TimeMs([&]() {
+			for (size_t i = 0; i < writes; i++)
+				Q.insert_or_assign(keys[gen() % n], static_cast<int>(i));
+		});
+		double plainWrites = TimeMs([&]() {
+			for (size_t i = 0; i < writes; i++)
+				P.insert_or_assign(keys[gen() % n], static_cast<int>(i));
+		});
+		sjtu::persistent_map<int, int> S;
+		double snapshot = TimeMs([&]() {
+			S = P.snapshot();
+		});
+		// every write now copies its path, until P owns it again
+		double sharedWrites = TimeMs([&]() {
+			for (size_t i = 0; i < writes; i++)
+				P.insert_or_assign(keys[gen() % n], static_cast<int>(i));
+		});
+		double drop = TimeMs([&]() {
+			S.clear();
+		});
+		std::cout << "n " << std::setw(8) << n << std::fixed << std::setprecision(3)
+			<< "  map copy " << std::setw(9) << copy << " ms"
+			<< "  snapshot " << std::setw(6) << snapshot << " ms"
+			<< "  dropped after the writes " << std::setw(8) << drop << " ms"
+			<< std::setprecision(1)
+			<< "  100k writes: map " << std::setw(6) << mapWrites << " ms"
+			<< "  persistent " << std::setw(6) << plainWrites << " ms"
+			<< "  after snapshot " << std::setw(6) << sharedWrites << " ms" << std::endl;
+	}
+}
+
+/**
+* merging maps of n and m elements: the join-based set_union, which moves
+*   nodes, against inserting the smaller map element by element.
+*/
+void TestSetOps()
+{
+	std::cout << "Set union, n = 2000000..." << std::endl;
+	const int n = 2000000;
+	for (int m = 1000; m <= n; m *= 10)
+	{
+		std::mt19937 gen(m);
+		sjtu::map<int, int> A, B, Aloop, Bloop;
+		for (int i = 0; i < n; i++)
+		{
+			int k = static_cast<int>(gen() & 0x7fffffff);
+			A[k] = i;
+			Aloop[k] = i;
+		}
+		for (int i = 0; i < m; i++)
+		{
+			int k = static_cast<int>(gen() & 0x7fffffff);
+			B[k] = i;
+			Bloop[k] = i;
+		}
+		double loop = TimeMs([&]() {
+			for (sjtu::map<int, int>::const_iterator it = Bloop.cbegin(); it != Bloop.cend(); ++it)
+				Aloop.insert(*it);
+		});
+		double join = TimeMs([&]() {
+			A.set_union(B);
+		});
+		std::cout << "m " << std::setw(8) << m << std::fixed << std::setprecision(2)
+			<< "  insert loop " << std::setw(8) << loop << " ms"
+			<< "  set_union " << std::setw(8) << join << " ms"
+			<< "  (" << A.size() - Aloop.size() << ")" << std::endl;
+	}
+}
+
+/**
+* bulk insert of random pairs as in check1, one by one against
+*   parallel_insert(), and set_union() against parallel_union().
+*/
+void TestParallel()
+{
+	std::cout << "Parallel bulk insert and union, n = 4000000, " << std::thread::hardware_concurrency() << " hardware threads..." << std::endl;
+	const int n = 4000000;
+	std::mt19937 gen(22);
+	std::vector<sjtu::pair<int, int> > in;
+	for (int i = 0; i < n; i++)
+		in.push_back(sjtu::pair<int, int>(static_cast<int>(gen() & 0x7fffffff), i));
+	sjtu::map<int, int> seq;
+	double loop = TimeMs([&]() {
+		for (size_t i = 0; i < in.size(); i++)
+			seq.insert(sjtu::map<int, int>::value_type(in[i].first, in[i].second));
+	});
+	std::cout << "insert loop     " << std::fixed << std::setprecision(2) << std::setw(9) << loop << " ms" << std::endl;
+	for (unsigned threads = 1; threads <= 8; threads *= 2)
+	{
+		sjtu::map<int, int> bulk;
+		double ms = TimeMs([&]() {
+			bulk.parallel_insert(in.begin(), in.end(), threads);
+		});
+		std::cout << "parallel_insert " << std::setw(9) << ms << " ms  " << threads << " threads  x"
+			<< std::setprecision(2) << loop / ms << (bulk.size() == seq.size() ? "" : "  (size differs)") << std::endl;
+	}
+	for (unsigned threads = 1; threads <= 8; threads *= 2)
+	{
+		sjtu::map<int, int> A, B;
+		A.parallel_insert(in.begin(), in.begin() + n / 2);
+		B.parallel_insert(in.begin() + n / 2, in.end());
+		double ms = TimeMs([&]() {
+			A.parallel_union(B, threads);
+		});
+		std::cout << "parallel_union  " << std::setw(9) << ms << " ms  " << threads << " threads" << std::endl;
+	}
+}
+
+/**
+* batches of mixed upserts and erases on a map of n elements, one by one
+*   against apply_batch().
+*/
+void TestBatch()
+{
+	std::cout << "Batched updates, n = 1000000, 2/3 upserts..." << std::endl;
+	typedef sjtu::map<int, int> Map;
+	const int n = 1000000, range = 2 * n;
+	for (int m = 100; m <= 1000000; m *= 10)
+	{
+		std::mt19937 gen(m);
+		Map loopQ, batchQ;
+		for (int i = 0; i < n; i++)
+		{
+			int k = static_cast<int>(gen() % range);
+			loopQ[k] = i;
+			batchQ[k] = i;
+		}
+		sjtu::vector<Map::batch_op> ops;
+		for (int i = 0; i < m; i++)
+		{
+			int k = static_cast<int>(gen() % range);
+			if (gen() % 3 == 0)
+				ops.push_back(Map::batch_op::erase(k));
+			else
+				ops.push_back(Map::batch_op::upsert(k, i));
+		}
+		double loop = TimeMs([&]() {
+			for (size_t i = 0; i < ops.size(); i++)
+			{
+				if (ops[i].kind == Map::batch_op::UPSERT)
+					loopQ[ops[i].key] = ops[i].value;
+				else
+				{
+					Map::iterator it = loopQ.find(ops[i].key);
+					if (it != loopQ.end())
+						loopQ.erase(it);
+				}
+			}
+		});
+		double batch = TimeMs([&]() {
+			batchQ.apply_batch(ops);
+		});
+		std::cout << "m " << std::setw(8) << m << std::fixed << std::setprecision(2)
+			<< "  one by one " << std::setw(8) << loop << " ms"
+			<< "  apply_batch " << std::setw(8) << batch << " ms"
+			<< (loopQ.size() == batchQ.size() ? "" : "  (size differs)") << std::endl;
+	}
+}
+
+/**
+* erasing a range of k elements out of n, one iterator at a time against
+*   erase(first, last).
+*/
+void TestRangeErase()
+{
+	std::cout << "Range erase, n = 2000000..." << std::endl;
+	const int n = 2000000;
+	for (int k = 10; k <= n / 2; k *= 100)
+	{
+		sjtu::map<int, int> loopQ, rangeQ;
+		for (int i = 0; i < n; i++)
+		{
+			loopQ[i] = i;
+			rangeQ[i] = i;
+		}
+		double loop = TimeMs([&]() {
+			sjtu::map<int, int>::iterator it = loopQ.lower_bound(n / 4), last = loopQ.lower_bound(n / 4 + k);
+			while (it != last)
+				it = loopQ.erase(it);
+		});
+		double range = TimeMs([&]() {
+			rangeQ.erase(rangeQ.lower_bound(n / 4), rangeQ.lower_bound(n / 4 + k));
+		});
+		std::cout << "k " << std::setw(8) << k << std::fixed << std::setprecision(3)
+			<< "  one by one " << std::setw(9) << loop << " ms"
+			<< "  erase(first, last) " << std::setw(9) << range << " ms"
+			<< (loopQ.size() == rangeQ.size() ? "" : "  (size differs)") << std::endl;
+	}
+}
+
+/**
+* moving entries back and forth between a hot and a cold map: find, copy,
+*   erase and insert against extract() and insert(node_type&&).
+*/
+void TestNodeMove()
+{
+	std::cout << "Moving entries between maps, 1000000 moves..." << std::endl;
+	typedef sjtu::map<int, std::string> Map;
+	const int n = 100000, moves = 1000000;
+	Map hotCopy, coldCopy, hotNode, coldNode;
+	for (int i = 0; i < n; i++)
+	{
+		std::string v = "value of " + std::to_string(i) + ", long enough to live on the heap";
+		hotCopy[i] = v;
+		hotNode[i] = v;
+	}
+	std::mt19937 gen(25);
+	std::vector<int> keys;
+	for (int i = 0; i < moves; i++)
+		keys.push_back(static_cast<int>(gen() % n));
+	double copy = TimeMs([&]() {
+		for (size_t i = 0; i < keys.size(); i++)
+		{
+			Map &from = i % 2 ? coldCopy : hotCopy, &to = i % 2 ? hotCopy : coldCopy;
+			Map::iterator it = from.find(keys[i]);
+			if (it == from.end())
+				continue;
+			Map::value_type value(*it);
+			from.erase(it);
+			to.insert(value);
+		}
+	});
+	double node = TimeMs([&]() {
+		for (size_t i = 0; i < keys.size(); i++)
+		{
+			Map &from = i % 2 ? coldNode : hotNode, &to = i % 2 ? hotNode : coldNode;
+			Map::node_type nh = from.extract(keys[i]);
+			if (!nh.empty())
+				to.insert(std::move(nh));
+		}
+	});
+	std::cout << std::fixed << std::setprecision(2)
+		<< "find + copy + erase + insert " << std::setw(8) << copy << " ms"
+		<< "  extract + insert " << std::setw(8) << node << " ms"
+		<< (hotCopy.size() == hotNode.size() ? "" : "  (size differs)") << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+	// the largest engine run, e.g. 1e8, which needs about 4 GB
+	size_t maxN = argc > 1 ? static_cast<size_t>(atof(argv[1])) : 10000000;
+	TestLayout();
+	TestHintedInsert();
+	TestEngines(maxN);
+	TestFrozen();
+	TestConcurrent();
+	TestSkiplist();
+	TestSnapshot();
+	TestSetOps();
+	TestParallel();
+	TestBatch();
+	TestRangeErase();
+	TestNodeMove();
+	return 0;
+}
@@ -8,8 +8,16 @@
 #include <iostream>
 #include <functional>
 #include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <algorithm>
+#include <thread>
+#include <exception>
 #include "utility.hpp"
 #include "exceptions.hpp"
+#include "pool.hpp"
+#include "frozen-map.hpp"
 
 #define RED   0
 #define BLACK 1
@@ -17,10 +25,172 @@
 
 namespace sjtu {
 
+	template<typename T> class vector;
+
+	/**
+	* augmentation policies: what every node keeps about its subtree.
+	* data is a base of the node, update() recomputes it from the node and
+	*   its children and is run bottom-up wherever the tree changes shape,
+	*   including the rotations of both fix-ups.
+	*/
+	class no_augment {
+	public:
+		class data {};
+		static const bool enabled = false;
+		static const bool counts = false;
+		static const bool reduces = false;
+		template<class Node>
+		static void update(Node *) {}
+	};
+	/**
+	* subtree sizes: rank(), select() and iterator arithmetic in O(log n).
+	*/
+	class order_statistic {
+	public:
+		class data {
+		public:
+			size_t count;
+		};
+		static const bool enabled = true;
+		static const bool counts = true;
+		static const bool reduces = false;
+		template<class Node>
+		static size_t count(const Node *p) {
+			return p == NULL ? 0 : p->count;
+		}
+		template<class Node>
+		static void update(Node *p) {
+			p->count = 1 + count(p->left) + count(p->right);
+		}
+	};
+	/**
+	* the combination of a measure over every subtree: range_reduce() in O(log n).
+	* Monoid provides
+	*   value_type, with a trivial destructor,
+	*   static value_type identity(),
+	*   static value_type combine(const value_type &, const value_type &), associative,
+	*   static value_type measure(const pair<const Key, T> &) for one element.
+	* combine is applied in key order, so it does not have to be commutative.
+	* a value changed in place (operator[], through an iterator) must be
+	*   followed by map::refresh() on its position.
+	*/
+	template<class Monoid>
+	class aggregate {
+	public:
+		typedef typename Monoid::value_type value_type;
+		static_assert(std::is_trivially_destructible<value_type>::value, "the aggregate is never destroyed");
+		class data {
+		public:
+			value_type total;
+		};
+		static const bool enabled = true;
+		static const bool counts = false;
+		static const bool reduces = true;
+		static value_type identity() {
+			return Monoid::identity();
+		}
+		static value_type combine(const value_type &a, const value_type &b) {
+			return Monoid::combine(a, b);
+		}
+		template<class Node>
+		static value_type total(const Node *p) {
+			return p == NULL ? Monoid::identity() : p->total;
+		}
+		template<class Node>
+		static value_type measure(const Node *p) {
+			return Monoid::measure(p->value());
+		}
+		template<class Node>
+		static void update(Node *p) {
+			p->total = Monoid::combine(Monoid::combine(total(p->left), measure(p)), total(p->right));
+		}
+	};
+
+	/**
+	* links and colour of a red-black tree node.
+	* packed_links keeps the colour (RED, BLACK or NIL) in the low bits of the
+	*   parent pointer, so a node costs three pointers plus its value.
+	* plain_links keeps it in a separate int; define SJTU_MAP_PLAIN_NODE to use it.
+	*/
+	template<class Node>
+	class packed_links {
+	public:
+		packed_links() : left(NULL), right(NULL), parentType(NIL) {}
+		Node* getParent() const {
+			return reinterpret_cast<Node*>(parentType & ~TYPE_MASK);
+		}
+		void setParent(Node *p) {
+			parentType = reinterpret_cast<uintptr_t>(p) | (parentType & TYPE_MASK);
+		}
+		int getType() const {
+			return static_cast<int>(parentType & TYPE_MASK);
+		}
+		void setType(const int &type) {
+			parentType = (parentType & ~TYPE_MASK) | static_cast<uintptr_t>(type);
+		}
+	public:
+		Node *left;
+		Node *right;
+	private:
+		static const uintptr_t TYPE_MASK = 3;
+		uintptr_t parentType;
+	};
+	template<class Node>
+	class plain_links {
+	public:
+		plain_links() : left(NULL), right(NULL), parent(NULL), type(NIL) {}
+		Node* getParent() const {
+			return parent;
+		}
+		void setParent(Node *p) {
+			parent = p;
+		}
+		int getType() const {
+			return type;
+		}
+		void setType(const int &type) {
+			this->type = type;
+		}
+	public:
+		Node *left;
+		Node *right;
+	private:
+		Node *parent;
+		int type;
+	};
+
+	/**
+	* leaves are NULL pointers; every tree owns one header node (type NIL)
+	*   whose parent is the root, and the root's parent is the header.
+	* the header's left and right point at the leftmost and rightmost node
+	*   (at the header itself when the tree is empty).
+	* the header is the past-the-end node.
+	*/
+	template<template<class> class Links, class Value, class Extra = no_augment::data>
+	class rb_node : public Links<rb_node<Links, Value, Extra> >, public Extra {
+	public:
+		rb_node() {}
+		rb_node(const int &color) { this->setType(color); }
+		Value & value() {
+			return *reinterpret_cast<Value*>(&storage);
+		}
+		const Value & value() const {
+			return *reinterpret_cast<const Value*>(&storage);
+		}
+	public:
+		// the element lives in the node itself, RBTree constructs and destroys it in place
+		typename std::aligned_storage<sizeof(Value), alignof(Value)>::type storage;
+	};
+
+	/**
+	* Augment chooses what the nodes keep about their subtrees, see no_augment,
+	*   order_statistic and aggregate.
+	*/
 	template<
 		class Key,
 		class T,
-		class Compare = std::less<Key>
+		class Compare = std::less<Key>,
+		class Augment = no_augment
 	> class map {
 	public:
 		/**
@@ -30,595 +200,1851 @@ namespace sjtu {
 		*/
 		typedef pair<const Key, T> value_type;
 		/**
-		* see BidirectionalIterator at CppReference for help.
-		*
-		* if there is anything wrong throw invalid_iterator.
-		*     like it = map.begin(); --it;
-		*       or it = map.end(); ++end();
+		* one operation of a batch for apply_batch(): an upsert, which sets the
+		*   value of key, or an erase of key.
+		* result is filled in by apply_batch(): whether the key was new to the
+		*   map for an upsert, or was in it for an erase.
 		*/
-
-		class Node {
+		class batch_op {
 		public:
-			Node() { vt = NULL; left = right = NULL; type = NIL; }
-			Node(Node *other)
+			enum kind_type { UPSERT, ERASE };
+			batch_op(kind_type kind, const Key &key, const T &value) : kind(kind), key(key), value(value), result(false) {}
+			static batch_op upsert(const Key &key, const T &value)
 			{
-				if (other->vt != NULL)
-					vt = new value_type(*other->vt);
-				else
-					vt = NULL;
-				type = other->type;
-				left = right = parent = NULL;
-			}
-			Node(const int &color) { vt = NULL; type = color; left = right = nullptr; }
-			Node(const value_type &value)
-			{
-				vt = new value_type(value);
-				parent = NULL;
-				type = RED;
-				left = new Node(NIL);
-				right = new Node(NIL);
-				left->parent = right->parent = this;
-			}
-			~Node()
-			{
-				if (vt)
-					delete vt;
-				vt = NULL;
-				type = NIL;
-				if (left)
-				{
-					left = NULL;
-				}
-				if (right)
-				{
-					right = NULL;
-				}
-				if(parent)
-					parent = NULL;
+				return batch_op(UPSERT, key, value);
 			}
-			void initialNode(const value_type &value)
+			static batch_op erase(const Key &key)
 			{
-				vt = new value_type(value);
-				this->type = RED;
-				if(!left)
-					left = new Node(NIL);
-				else
-					left->type = NIL;
-				if(!right)
-					right = new Node(NIL);
-				else
-					right->type = NIL;
-				left->parent = right->parent = this;
-			}
-			//bool operator==(const Node &right)
-			//{
-			//	if(this != NULL)
-			//		if (this->type == NIL)
-			//			return NULL == right;
-			//	return this == right;
-			//}
-			//bool operator!=(const Node &right)
-			//{
-			//	if (this != NULL)
-			//		if(this->type == NIL)
-			//			return NULL != right;
-			//	return this != right;
-			//}
-			value_type* operator->() const noexcept {
-				return vt;
+				return batch_op(ERASE, key, T());
 			}
-		public:
-			value_type *vt;
-			Node *left;
-			Node *right;
-			Node *parent;
-			int type;
+			kind_type kind;
+			Key key;
+			T value;
+			bool result;
 		};
+		/**
+		* see BidirectionalIterator at CppReference for help.
+		*
+		* if there is anything wrong throw invalid_iterator.
+		*     like it = map.begin(); --it;
+		*       or it = map.end(); ++end();
+		*/
+
+#ifdef SJTU_MAP_PLAIN_NODE
+		typedef rb_node<plain_links, value_type, typename Augment::data> Node;
+#else
+		typedef rb_node<packed_links, value_type, typename Augment::data> Node;
+		static_assert(alignof(Node) > 2, "packed_links needs two free low bits in a node pointer");
+#endif
 		class RBTree {
 		private:
-			Node *root;
-			size_t _size;
+			Node header;
+			// exact only while counted, see size()
+			mutable size_t _size;
+			mutable bool counted;
 			Compare comp;
+			shared_slab_pool<sizeof(Node), alignof(Node)> nodePool;
 		public:
 			RBTree()
 			{
-				root = NULL;
 				comp = Compare();
 				_size = 0;
+				counted = true;
+				header.left = header.right = &header;
 			}
 			RBTree(const RBTree &other)
 			{
-				copyTree(other.root);
-				_size = other.size();
+				comp = other.comp;
+				_size = 0;
+				counted = true;
+				header.left = header.right = &header;
+				assign(other);
 			}
 			RBTree& operator=(const RBTree &other)
 			{
-				copyTree(other.root);
-				_size = other.size();
+				if (this != &other)
+					assign(other);
 				return *this;
 			}
 			~RBTree()
 			{
-				if (root)
-					clear();
+				clear();
 			}
-			size_t size()
+			/**
+			* a split leaves the size of both parts unknown; it is counted on
+			*   the first call after, in O(n), or read off the root in O(1)
+			*   when the Augment counts.
+			*/
+			size_t size() const
 			{
+				if (!counted)
+				{
+					_size = countNodes(root(), std::integral_constant<bool, Augment::counts>());
+					counted = true;
+				}
 				return _size;
 			}
-			bool empty()
+			bool empty() const
 			{
-				return _size == 0;
+				return root() == NULL;
 			}
+			/**
+			* values are destroyed in place (skipped when that is a no-op),
+			* then the slabs holding the nodes are dropped as a whole.
+			* a pool shared with other trees keeps its slabs: the nodes go back
+			*   one by one and the tree starts a pool of its own.
+			*/
 			void clear()
 			{
-				if(root)
-					clearNode(root);
-				_size = 0;
-				root = NULL;
-			}
-			Node* begin() {
-				Node* rNode = root;
-				if (root == NULL || root->type == NIL)
+				if (nodePool.shared())
 				{
-					return rNode;
+					if (root())
+						freeTree(root());
+					nodePool.leave();
 				}
-				while (rNode->left != NULL && rNode->type != NIL)
+				else
 				{
-					rNode = rNode->left;
+					if (root() && !std::is_trivially_destructible<value_type>::value)
+						clearNode(root());
+					nodePool.release();
 				}
-				return rNode->parent;
+				_size = 0;
+				counted = true;
+				setRoot(NULL);
+				header.left = header.right = &header;
+			}
+			/**
+			* an empty tree holds no node of the pool it shares, so it lets go
+			*   of it and allocates without the pool's lock again.
+			*/
+			void leaveIfEmpty()
+			{
+				if (root() == NULL && nodePool.shared())
+					nodePool.leave();
+			}
+			bool poolShared() const
+			{
+				return nodePool.shared();
+			}
+			Node* begin() {
+				return header.left;
 			}
 			Node* end() {
-				Node* rNode = root;
-				if (root == NULL || root->type == NIL)
-				{
-					return rNode;
-				}
-				while (rNode->right != NULL)
+				return &header;
+			}
+			/**
+			* one descent for key.
+			* returns the node holding key, or NULL after setting pNode and toLeft
+			*   to the spot where a node for key has to be linked.
+			*/
+			Node* locate(const Key &key, Node *&pNode, bool &toLeft)
+			{
+				pNode = &header;
+				toLeft = true;
+				Node* cNode = root();
+				while (cNode != NULL)
 				{
-					rNode = rNode->right;
+					pNode = cNode;
+					if (comp(key, cNode->value().first))
+					{
+						toLeft = true;
+						cNode = cNode->left;
+					}
+					else if (comp(cNode->value().first, key))
+					{
+						toLeft = false;
+						cNode = cNode->right;
+					}
+					else // value already exist
+					{
+						return cNode;
+					}
 				}
-				return rNode;
+				return NULL;
 			}
-			Node* insert(const value_type &value) {
-				if (root == NULL)
+			/**
+			* same contract as locate(), but first try the neighbours of hint:
+			*   when key belongs right before or right after hint the node is
+			*   linked there after one or two comparisons.
+			* sorted input with the previous result as hint costs amortized O(1).
+			*/
+			Node* locateHint(Node *hint, const Key &key, Node *&pNode, bool &toLeft)
+			{
+				if (hint == NULL || root() == NULL)
+					return locate(key, pNode, toLeft);
+				if (hint == &header)
 				{
-					root = new Node(value);
-					root->type = BLACK;
-					_size++;
-					return root;
+					// append after the largest key
+					if (comp(header.right->value().first, key))
+					{
+						pNode = header.right;
+						toLeft = false;
+						return NULL;
+					}
+					return locate(key, pNode, toLeft);
 				}
-				Node* pNode = NULL;
-				Node* cNode = root;
-				while (cNode != NULL && cNode->type != NIL)
+				if (comp(key, hint->value().first))
 				{
-					if (comp(cNode->vt->first, value.first))
+					// key goes between prev and hint
+					if (hint == header.left)
 					{
-						pNode = cNode;
-						cNode = cNode->right;
+						pNode = hint;
+						toLeft = true;
+						return NULL;
 					}
-					else if (comp(value.first, cNode->vt->first))
+					Node* prev = prevNode(hint);
+					if (comp(prev->value().first, key))
 					{
-						pNode = cNode;
-						cNode = cNode->left;
+						// one of the two has a free link on the facing side
+						if (prev->right == NULL)
+						{
+							pNode = prev;
+							toLeft = false;
+						}
+						else
+						{
+							pNode = hint;
+							toLeft = true;
+						}
+						return NULL;
 					}
-					else // value already exist
+					return locate(key, pNode, toLeft);
+				}
+				if (comp(hint->value().first, key))
+				{
+					// key goes between hint and next
+					if (hint == header.right)
+					{
+						pNode = hint;
+						toLeft = false;
+						return NULL;
+					}
+					Node* next = nextNode(hint);
+					if (comp(key, next->value().first))
 					{
+						if (hint->right == NULL)
+						{
+							pNode = hint;
+							toLeft = false;
+						}
+						else
+						{
+							pNode = next;
+							toLeft = true;
+						}
 						return NULL;
 					}
+					return locate(key, pNode, toLeft);
+				}
+				return hint;
+			}
+			/**
+			* build a value from args in a new node and link it at the spot
+			*   locate() reported, without comparing keys again.
+			*/
+			template<class... Args>
+			Node* insertAt(Node *pNode, bool toLeft, Args&&... args)
+			{
+				return link(newNode(std::forward<Args>(args)...), pNode, toLeft);
+			}
+			/**
+			* build the value first, then look for its key.
+			* if the key is taken the new node is dropped again.
+			*/
+			template<class... Args>
+			pair<Node*, bool> emplace(Args&&... args)
+			{
+				Node* cNode = newNode(std::forward<Args>(args)...);
+				Node* pNode;
+				bool toLeft;
+				Node* oNode = locate(cNode->value().first, pNode, toLeft);
+				if (oNode != NULL)
+				{
+					freeNode(cNode);
+					return pair<Node*, bool>(oNode, false);
 				}
-				// insert
-				cNode->initialNode(value);
-				cNode->parent = pNode;
-				if (comp(value.first, pNode->vt->first))
+				return pair<Node*, bool>(link(cNode, pNode, toLeft), true);
+			}
+			template<class... Args>
+			pair<Node*, bool> emplaceHint(Node *hint, Args&&... args)
+			{
+				Node* cNode = newNode(std::forward<Args>(args)...);
+				Node* pNode;
+				bool toLeft;
+				Node* oNode = locateHint(hint, cNode->value().first, pNode, toLeft);
+				if (oNode != NULL)
+				{
+					freeNode(cNode);
+					return pair<Node*, bool>(oNode, false);
+				}
+				return pair<Node*, bool>(link(cNode, pNode, toLeft), true);
+			}
+			Node* link(Node *cNode, Node *pNode, bool toLeft)
+			{
+				cNode->setParent(pNode);
+				if (pNode == &header)
+				{
+					setRoot(cNode);
+					header.left = header.right = cNode;
+				}
+				else if (toLeft)
 				{
 					pNode->left = cNode;
+					if (pNode == header.left)
+						header.left = cNode;
 				}
-				else if (comp(pNode->vt->first, value.first))
+				else
 				{
 					pNode->right = cNode;
+					if (pNode == header.right)
+						header.right = cNode;
 				}
+				updatePath(cNode);
 
 				// fixed up
 				insert_fixed_up(cNode);
 				_size++;
 				return cNode;
 			}
-			Node* find(Key key) {
-				Node *ret = NULL;
-				if (root == NULL)
-					return ret;
-				ret = root;
-				while (ret != NULL && ret->vt && ret->type != NIL) {
-					if (comp(key, ret->vt->first))
+			/**
+			* returns the new node, or the node holding the key and false.
+			*/
+			pair<Node*, bool> insert(const value_type &value) {
+				Node* pNode;
+				bool toLeft;
+				Node* cNode = locate(value.first, pNode, toLeft);
+				if (cNode != NULL)
+					return pair<Node*, bool>(cNode, false);
+				return pair<Node*, bool>(insertAt(pNode, toLeft, value), true);
+			}
+			pair<Node*, bool> insert(value_type &&value) {
+				Node* pNode;
+				bool toLeft;
+				Node* cNode = locate(value.first, pNode, toLeft);
+				if (cNode != NULL)
+					return pair<Node*, bool>(cNode, false);
+				return pair<Node*, bool>(insertAt(pNode, toLeft, std::move(value)), true);
+			}
+			/**
+			* lookups take any K that comp can compare with Key, by reference.
+			*/
+			template<class K>
+			Node* find(const K &key) {
+				Node *cNode = root();
+				while (cNode != NULL)
+				{
+					if (comp(key, cNode->value().first))
+						cNode = cNode->left;
+					else if (comp(cNode->value().first, key))
+						cNode = cNode->right;
+					else
+						return cNode;
+				}
+				return NULL;
+			}
+			bool compare(const Key &a, const Key &b) const
+			{
+				return comp(a, b);
+			}
+			const Compare & keyComp() const
+			{
+				return comp;
+			}
+			// the first node whose key is not less than key, or the header
+			template<class K>
+			Node* lowerBound(const K &key) {
+				Node *res = &header;
+				Node *cNode = root();
+				while (cNode != NULL)
+				{
+					if (comp(cNode->value().first, key))
+						cNode = cNode->right;
+					else
 					{
-						ret = ret->left;
+						res = cNode;
+						cNode = cNode->left;
 					}
-					else if (comp(ret->vt->first, key))
+				}
+				return res;
+			}
+			// the first node whose key is greater than key, or the header
+			template<class K>
+			Node* upperBound(const K &key) {
+				Node *res = &header;
+				Node *cNode = root();
+				while (cNode != NULL)
+				{
+					if (comp(key, cNode->value().first))
 					{
-						ret = ret->right;
+						res = cNode;
+						cNode = cNode->left;
 					}
 					else
-					{
-						break;
-					}
+						cNode = cNode->right;
 				}
-				if (ret->vt && !(comp(ret->vt->first, key) && comp(key, ret->vt->first)))
-					return ret;
-				else
-					return NULL;
+				return res;
 			}
-			void remove(const value_type &value)
+			/**
+			* take p out of the tree for a node handle, whose pool enters this
+			*   tree's group so the node outlives the tree if need be.
+			*/
+			void extract(Node *p, shared_slab_pool<sizeof(Node), alignof(Node)> &pool)
 			{
-				Node* tNode;
-				Node* sNode;
-				Node* cNode = find(value.first);
-				if (cNode == NULL)
-					return;
-				if (cNode->left->type == NIL || cNode->right->type == NIL)
-				{
-					tNode = cNode;
-				}
-				else
+				unlink(p);
+				_size--;
+				pool.enter(nodePool);
+				leaveIfEmpty();
+			}
+			/**
+			* link the detached node x where its key goes, taking in the pool
+			*   it came from; or return the node holding the key and false,
+			*   leaving x and pool alone.
+			*/
+			pair<Node*, bool> insertNode(Node *x, shared_slab_pool<sizeof(Node), alignof(Node)> &pool)
+			{
+				Node *pNode;
+				bool toLeft;
+				Node *p = locate(x->value().first, pNode, toLeft);
+				if (p != NULL)
+					return pair<Node*, bool>(p, false);
+				nodePool.share(pool);
+				pool.leave();
+				x->left = x->right = NULL;
+				x->setType(RED);
+				return pair<Node*, bool>(link(x, pNode, toLeft), true);
+			}
+			/**
+			* unlink cNode and free it.
+			* a node with two children is replaced by its successor node itself,
+			*   no value is copied and every other node stays where it is.
+			*/
+			void remove(Node *cNode)
+			{
+				unlink(cNode);
+				freeNode(cNode);
+				_size--;
+				leaveIfEmpty();
+			}
+			/**
+			* free the nodes from first up to last, not included, which may be
+			*   the header. a range shorter than the black height is removed
+			*   node by node; a longer one is cut out with two splits and a
+			*   join, O(log n) plus freeing it.
+			*/
+			void eraseRange(Node *first, Node *last)
+			{
+				Node *p = first;
+				for (int h = blackHeight(root()); h > 0 && p != last; h--)
+					p = nextNode(p);
+				if (p == last)
 				{
-					tNode = nextNode(cNode);
+					while (first != last)
+					{
+						p = nextNode(first);
+						remove(first);
+						first = p;
+					}
+					return;
 				}
-
-				if (tNode->left && tNode->left->type != NIL)
+				bool known = counted;
+				size_t n = _size, removed = 1;
+				subtree l, rest, r;
+				Node *mid;
+				split(take(), first->value().first, l, mid, rest);
+				freeNode(first);
+				if (last == &header)
 				{
-					sNode = tNode->left;
-					tNode->left = NULL;
+					if (rest.root != NULL)
+						removed += freeTree(rest.root);
+					settle(l);
 				}
 				else
 				{
-					sNode = tNode->right;
-					tNode->right = NULL;
+					split(rest, last->value().first, rest, mid, r);
+					if (rest.root != NULL)
+						removed += freeTree(rest.root);
+					settle(join(l, last, r));
 				}
-
-				if (tNode == root)
+				_size = n - removed;
+				counted = known;
+				leaveIfEmpty();
+			}
+			// whether p is a node of this tree or its header, by climbing to the header
+			bool owns(const Node *p) const
+			{
+				while (p->getType() != NIL)
+					p = p->getParent();
+				return p == &header;
+			}
+			// take cNode out of the tree, leaving it to the caller
+			void unlink(Node *cNode)
+			{
+				if (cNode == header.left)
+					header.left = nextNode(cNode);
+				if (cNode == header.right)
 				{
-					root = sNode;
+					Node *p = prevNode(cNode);
+					header.right = p == NULL ? &header : p;
 				}
+				Node* tNode = cNode;
+				Node* sNode;	// the child taking the place of the unlinked position
+				Node* pNode;	// its parent
+				if (cNode->left == NULL)
+					sNode = cNode->right;
+				else if (cNode->right == NULL)
+					sNode = cNode->left;
 				else
 				{
-					if (tNode == tNode->parent->left)
-						tNode->parent->left = sNode;
-					else
-						tNode->parent->right = sNode;
+					tNode = leftmost(cNode->right);
+					sNode = tNode->right;
 				}
-				sNode->parent = tNode->parent;
-
 				if (tNode != cNode)
 				{
-					if (tNode->type != NIL)
+					// relink the successor tNode in place of cNode
+					cNode->left->setParent(tNode);
+					tNode->left = cNode->left;
+					if (tNode != cNode->right)
 					{
-						delete cNode->vt;
-						cNode->vt = new value_type(*tNode->vt);
+						pNode = tNode->getParent();
+						if (sNode != NULL)
+							sNode->setParent(pNode);
+						pNode->left = sNode;
+						tNode->right = cNode->right;
+						cNode->right->setParent(tNode);
 					}
+					else
+						pNode = tNode;
+					replaceChild(cNode, tNode);
+					tNode->setParent(cNode->getParent());
+					// tNode takes over the colour of the position, cNode keeps the removed one
+					int type = tNode->getType();
+					tNode->setType(cNode->getType());
+					cNode->setType(type);
 				}
-				if (tNode->type == BLACK)
-					delete_fixed_up(sNode);
-				if (tNode->left)
-					delete tNode->left;
-				else if(tNode->right)
-					delete tNode->right;
-				delete tNode;
-				tNode = NULL;
-				if (root->type == NIL)
+				else
 				{
-					delete root;
-					root = NULL;
+					pNode = cNode->getParent();
+					if (sNode != NULL)
+						sNode->setParent(pNode);
+					replaceChild(cNode, sNode);
 				}
-				_size--;
+
+				updatePath(pNode);
+				if (cNode->getType() == BLACK)
+					delete_fixed_up(sNode, pNode);
 			}
 
 			void print()
 			{
-				printNode(root);
+				if (root())
+					printNode(root());
 			}
 			void printNode(Node* nd)
 			{
-				if (nd->left != NULL && nd->left->type != NIL)
+				if (nd->left != NULL)
 					printNode(nd->left);
-				std::cout << nd->vt->first << " " << nd->vt->second << " " << nd->type << std::endl;
-				if (nd->right != NULL && nd->right->type != NIL)
+				std::cout << nd->value().first << " " << nd->value().second << " " << nd->getType() << std::endl;
+				if (nd->right != NULL)
 					printNode(nd->right);
 			}
 
-		private:
-			Node* nextNode(Node *cNode)
+			/**
+			* in-order neighbours, shared by iterator and const_iterator.
+			* nextNode returns the header after the last element,
+			* prevNode returns NULL before the first one.
+			*/
+			static Node* nextNode(Node *cNode)
 			{
-				Node* t;
-				if (cNode->type != NIL && cNode->right->type != NIL)
+				if (cNode->right != NULL)
+					return leftmost(cNode->right);
+				Node* pNode = cNode->getParent();
+				while (pNode->getType() != NIL && cNode == pNode->right)
 				{
-					t = cNode->right;
-					while (t->left && t->left->type != NIL)
-						t = t->left;
-					return t;
+					cNode = pNode;
+					pNode = pNode->getParent();
 				}
-				t = cNode->parent;
-				while (t->type != NIL && cNode == t->parent->right)
+				return pNode;
+			}
+			static Node* prevNode(Node *cNode)
+			{
+				if (cNode->getType() == NIL)
+					return cNode->right == cNode ? NULL : cNode->right;
+				if (cNode->left != NULL)
+					return rightmost(cNode->left);
+				Node* pNode = cNode->getParent();
+				while (pNode->getType() != NIL && cNode == pNode->left)
 				{
-					cNode = t;
-					t = t->parent;
+					cNode = pNode;
+					pNode = pNode->getParent();
 				}
-				return t;
+				return pNode->getType() == NIL ? NULL : pNode;
 			}
-			void insert_fixed_up(Node* cNode)
+			/**
+			* order statistics, for trees whose Augment counts subtree sizes.
+			* rank is the number of keys less than key, select(k) the node with
+			*   rank k (the header when k >= size).
+			*/
+			template<class K>
+			size_t rank(const K &key)
 			{
-				Node *pNode = cNode->parent;
-				while (cNode != root && pNode->type == RED)
+				size_t r = 0;
+				Node *cNode = root();
+				while (cNode != NULL)
 				{
-					Node *gNode = pNode->parent;
-					Node *uNode = NULL;
-					// left
-					if (pNode == gNode->left)
+					if (comp(cNode->value().first, key))
 					{
-						uNode = gNode->right;
-						/* case-1:
-						* curr    left
-						* father  left  red
-						* uncle   right red
-						*/
-						if (uNode && uNode->type == RED)
-						{
-							pNode->type = uNode->type = BLACK;
-							gNode->type = RED;
-							cNode = gNode;
-							pNode = gNode->parent;
-							continue;
-						}
-						/* case-2:
-						* curr    left
-						* father  left  red
-						* uncle   right BLACK
-						*/
-						if (cNode == pNode->right)
-						{
-							Node *tmp;
-							leftRotate(pNode);
-							tmp = pNode;
-							pNode = cNode;
-							cNode = tmp;
-						}
-						/* case-3:
-						* curr    right
-						* father  left  red
-						* uncle   right BLACK
-						*/
-						pNode->type = BLACK;
-						gNode->type = RED;
-						rightRotate(gNode);
+						r += Augment::count(cNode->left) + 1;
+						cNode = cNode->right;
 					}
-					else if (pNode == gNode->right)
-					{
+					else
+						cNode = cNode->left;
+				}
+				return r;
+			}
+			static Node* select(Node *header, size_t k)
+			{
+				Node *cNode = header->getParent();
+				while (cNode != NULL)
+				{
+					size_t l = Augment::count(cNode->left);
+					if (k < l)
+						cNode = cNode->left;
+					else if (k == l)
+						return cNode;
+					else
+					{
+						k -= l + 1;
+						cNode = cNode->right;
+					}
+				}
+				return header;
+			}
+			// the header of the tree cNode belongs to
+			static Node* headerOf(Node *cNode)
+			{
+				while (cNode->getType() != NIL)
+					cNode = cNode->getParent();
+				return cNode;
+			}
+			// the rank of a node, climbing to the root; the header ranks after everything
+			static size_t rankOf(Node *cNode)
+			{
+				if (cNode->getType() == NIL)
+					return Augment::count(cNode->getParent());
+				size_t r = Augment::count(cNode->left);
+				Node *pNode = cNode->getParent();
+				while (pNode->getType() != NIL)
+				{
+					if (cNode == pNode->right)
+						r += Augment::count(pNode->left) + 1;
+					cNode = pNode;
+					pNode = pNode->getParent();
+				}
+				return r;
+			}
+			/**
+			* the node n places after cNode (before it if n < 0), in O(log n).
+			* throws index_out_of_bound if that falls outside [begin, end].
+			*/
+			static Node* advance(Node *cNode, long n)
+			{
+				static_assert(Augment::counts, "iterator arithmetic needs the order_statistic augmentation");
+				if (cNode == NULL)
+					throw invalid_iterator();
+				Node *h = headerOf(cNode);
+				long k = static_cast<long>(rankOf(cNode)) + n;
+				if (k < 0 || k > static_cast<long>(Augment::count(h->getParent())))
+					throw index_out_of_bound();
+				return select(h, static_cast<size_t>(k));
+			}
+			static long distance(Node *a, Node *b)
+			{
+				static_assert(Augment::counts, "iterator arithmetic needs the order_statistic augmentation");
+				if (a == NULL || b == NULL || headerOf(a) != headerOf(b))
+					throw invalid_iterator();
+				return static_cast<long>(rankOf(a)) - static_cast<long>(rankOf(b));
+			}
+			/**
+			* the aggregate of the keys in [lo, hi), for trees whose Augment reduces.
+			* below the first node inside the range, the left path only takes
+			*   whole right subtrees and the right path whole left subtrees.
+			*/
+			template<class K, class A = Augment>
+			typename A::value_type rangeReduce(const K &lo, const K &hi)
+			{
+				Node *sNode = root();
+				while (sNode != NULL)
+				{
+					if (comp(sNode->value().first, lo))
+						sNode = sNode->right;
+					else if (!comp(sNode->value().first, hi))
+						sNode = sNode->left;
+					else
+						break;
+				}
+				typename Augment::value_type left = Augment::identity();
+				if (sNode == NULL)
+					return left;
+				typename Augment::value_type right = left;
+				for (Node *cNode = sNode->left; cNode != NULL; )
+				{
+					if (comp(cNode->value().first, lo))
+						cNode = cNode->right;
+					else
+					{
+						left = Augment::combine(Augment::combine(Augment::measure(cNode), Augment::total(cNode->right)), left);
+						cNode = cNode->left;
+					}
+				}
+				for (Node *cNode = sNode->right; cNode != NULL; )
+				{
+					if (comp(cNode->value().first, hi))
+					{
+						right = Augment::combine(right, Augment::combine(Augment::total(cNode->left), Augment::measure(cNode)));
+						cNode = cNode->right;
+					}
+					else
+						cNode = cNode->left;
+				}
+				return Augment::combine(Augment::combine(left, Augment::measure(sNode)), right);
+			}
+			// the value of p was changed in place
+			void refresh(Node *p)
+			{
+				updatePath(p);
+			}
+			static Node* leftmost(Node *cNode)
+			{
+				while (cNode->left != NULL)
+					cNode = cNode->left;
+				return cNode;
+			}
+			static Node* rightmost(Node *cNode)
+			{
+				while (cNode->right != NULL)
+					cNode = cNode->right;
+				return cNode;
+			}
+		private:
+			Node* root() const
+			{
+				return header.getParent();
+			}
+			void setRoot(Node *p)
+			{
+				header.setParent(p);
+			}
+			// point the link that leads to cNode at nNode instead
+			void replaceChild(Node *cNode, Node *nNode)
+			{
+				if (cNode == root())
+					setRoot(nNode);
+				else if (cNode == cNode->getParent()->left)
+					cNode->getParent()->left = nNode;
+				else
+					cNode->getParent()->right = nNode;
+			}
+			// recompute the augmented data of p and of all its ancestors
+			void updatePath(Node *p)
+			{
+				if (!Augment::enabled)
+					return;
+				for (; p != &header; p = p->getParent())
+					Augment::update(p);
+			}
+			static bool isRed(const Node *p)
+			{
+				return p != NULL && p->getType() == RED;
+			}
+			// returns whether the root was red at the end, i.e. the black height grew
+			bool insert_fixed_up(Node* cNode)
+			{
+				while (cNode != root() && cNode->getParent()->getType() == RED)
+				{
+					Node *pNode = cNode->getParent();
+					Node *gNode = pNode->getParent();
+					Node *uNode;
+					// left
+					if (pNode == gNode->left)
+					{
+						uNode = gNode->right;
+						/* case-1:
+						* curr    left
+						* father  left  red
+						* uncle   right red
+						*/
+						if (isRed(uNode))
+						{
+							pNode->setType(BLACK);
+							uNode->setType(BLACK);
+							gNode->setType(RED);
+							cNode = gNode;
+							continue;
+						}
+						/* case-2:
+						* curr    left
+						* father  left  red
+						* uncle   right BLACK
+						*/
+						if (cNode == pNode->right)
+						{
+							cNode = pNode;
+							leftRotate(cNode);
+							pNode = cNode->getParent();
+						}
+						/* case-3:
+						* curr    right
+						* father  left  red
+						* uncle   right BLACK
+						*/
+						pNode->setType(BLACK);
+						gNode->setType(RED);
+						rightRotate(gNode);
+					}
+					else
+					{
 						uNode = gNode->left;
-						if (uNode && uNode->type == RED)
+						if (isRed(uNode))
 						{
-							pNode->type = uNode->type = BLACK;
-							gNode->type = RED;
+							pNode->setType(BLACK);
+							uNode->setType(BLACK);
+							gNode->setType(RED);
 							cNode = gNode;
-							pNode = gNode->parent;
 							continue;
 						}
 						if (cNode == pNode->left)
 						{
-							Node *tmp;
-							rightRotate(pNode);
-							tmp = pNode;
-							pNode = cNode;
-							cNode = tmp;
+							cNode = pNode;
+							rightRotate(cNode);
+							pNode = cNode->getParent();
 						}
-						pNode->type = BLACK;
-						gNode->type = RED;
+						pNode->setType(BLACK);
+						gNode->setType(RED);
 						leftRotate(gNode);
 					}
-					pNode = cNode->parent;
 				}
-				root->type = BLACK;
+				bool grew = root()->getType() == RED;
+				root()->setType(BLACK);
+				return grew;
 			}
 
-			void delete_fixed_up(Node* cNode)
+			/**
+			* cNode took the place of a removed black node and may be NULL,
+			* so its parent is passed in separately.
+			*/
+			void delete_fixed_up(Node* cNode, Node* pNode)
 			{
 				Node *wNode;
-				Node *pNode;
-				// set black if its red
-				if (cNode->type == RED)
-					cNode->type = BLACK;
-				else
+				while (cNode != root() && !isRed(cNode))
 				{
-					while (cNode != root && cNode->type != RED)
+					// left case
+					if (cNode == pNode->left)
 					{
-						pNode = cNode->parent;
-						// left case
-						if (cNode == cNode->parent->left)
+						wNode = pNode->right;
+						// case1: sibling is red. change to case 2-4
+						if (wNode->getType() == RED)
 						{
-							wNode = cNode->parent->right;
-							// case1: sibling is red. change to case 2-4
-							if (wNode->type == RED)
-							{
-								wNode->type = BLACK;
-								cNode->parent->type = RED;
-								leftRotate(pNode);
-								wNode = cNode->parent->right;
-							}
-							// case2:
-							if ((!wNode->left || wNode->left->type != RED) && (!wNode->right || wNode->right->type != RED))
-							{
-								if(wNode->type != NIL)
-									wNode->type = RED;
-								cNode = wNode->parent;
-							}
-							else
-							{
-								// case 3: to 4
-								if (!wNode->right || wNode->right->type != RED)
-								{
-									if (wNode->left && wNode->left->type != NIL)
-										wNode->left->type = BLACK;
-									if (wNode->type != NIL)
-										wNode->type = RED;
-									rightRotate(wNode);
-									wNode = cNode->parent->right;
-								}
-								// case 4:
-								wNode->type = cNode->parent->type;
-								cNode->parent->type = BLACK;
-								if (wNode->right && wNode->right->type != NIL)
-									wNode->right->type = BLACK;
-								pNode = cNode->parent;
-								leftRotate(pNode);
-								break;
-							}
+							wNode->setType(BLACK);
+							pNode->setType(RED);
+							leftRotate(pNode);
+							wNode = pNode->right;
+						}
+						// case2:
+						if (!isRed(wNode->left) && !isRed(wNode->right))
+						{
+							wNode->setType(RED);
+							cNode = pNode;
+							pNode = pNode->getParent();
 						}
-						// right case
 						else
 						{
-							wNode = cNode->parent->left;
-							if (wNode->type == RED)
-							{
-								wNode->type = BLACK;
-								cNode->parent->type = RED;
-								rightRotate(pNode);
-								wNode = cNode->parent->left;
-							}
-							if ((!wNode->left || wNode->left->type != RED) && (!wNode->right || wNode->right->type != RED))
+							// case 3: to 4
+							if (!isRed(wNode->right))
 							{
-								if (wNode->type != NIL)
-									wNode->type = RED;
-								cNode = wNode->parent;
+								wNode->left->setType(BLACK);
+								wNode->setType(RED);
+								rightRotate(wNode);
+								wNode = pNode->right;
 							}
-							else
+							// case 4:
+							wNode->setType(pNode->getType());
+							pNode->setType(BLACK);
+							if (wNode->right != NULL)
+								wNode->right->setType(BLACK);
+							leftRotate(pNode);
+							cNode = root();
+							break;
+						}
+					}
+					// right case
+					else
+					{
+						wNode = pNode->left;
+						if (wNode->getType() == RED)
+						{
+							wNode->setType(BLACK);
+							pNode->setType(RED);
+							rightRotate(pNode);
+							wNode = pNode->left;
+						}
+						if (!isRed(wNode->left) && !isRed(wNode->right))
+						{
+							wNode->setType(RED);
+							cNode = pNode;
+							pNode = pNode->getParent();
+						}
+						else
+						{
+							if (!isRed(wNode->left))
 							{
-								if (!wNode->left || wNode->left->type != RED)
-								{
-									if (wNode->right && wNode->right->type != NIL)
-										wNode->right->type = BLACK;
-									if (wNode->type != NIL)
-										wNode->type = RED;
-									leftRotate(wNode);
-									wNode = cNode->parent->left;
-								}
-								wNode->type = cNode->parent->type;
-								cNode->parent->type = BLACK;
-								if (wNode->left && wNode->left->type != NIL)
-									wNode->left->type = BLACK;
-								pNode = cNode->parent;
-								rightRotate(pNode);
-								break;
+								wNode->right->setType(BLACK);
+								wNode->setType(RED);
+								leftRotate(wNode);
+								wNode = pNode->left;
 							}
+							wNode->setType(pNode->getType());
+							pNode->setType(BLACK);
+							if (wNode->left != NULL)
+								wNode->left->setType(BLACK);
+							rightRotate(pNode);
+							cNode = root();
+							break;
+						}
+					}
+				} // end while
+				if (cNode != NULL)
+					cNode->setType(BLACK);
+			}
+
+			void leftRotate(Node* parent)
+			{
+				Node* subR = parent->right;
+				Node* subRL = subR->left;
+
+				parent->right = subRL;
+				if (subRL)
+					subRL->setParent(parent);
+
+				subR->setParent(parent->getParent());
+				if (parent == root())
+					setRoot(subR);
+				else if (parent == parent->getParent()->left)
+					parent->getParent()->left = subR;
+				else
+					parent->getParent()->right = subR;
+
+				subR->left = parent;
+				parent->setParent(subR);
+				if (Augment::enabled)
+				{
+					Augment::update(parent);
+					Augment::update(subR);
+				}
+			}
+
+			void rightRotate(Node* parent)
+			{
+				Node* subL = parent->left;
+				Node* subLR = subL->right;
+
+				parent->left = subLR;
+				if (subLR)
+					subLR->setParent(parent);
+
+				subL->setParent(parent->getParent());
+				if (parent == root())
+					setRoot(subL);
+				else if (parent == parent->getParent()->right)
+					parent->getParent()->right = subL;
+				else
+					parent->getParent()->left = subL;
+
+				subL->right = parent;
+				parent->setParent(subL);
+				if (Augment::enabled)
+				{
+					Augment::update(parent);
+					Augment::update(subL);
+				}
+			}
+		public:
+			/**
+			* whether values are strictly increasing under comp, n - 1 comparisons.
+			*/
+			template<class V>
+			bool isSorted(const vector<V> &values)
+			{
+				for (size_t i = 1; i < values.size(); i++)
+				{
+					if (!comp(values[i - 1].first, values[i].first))
+						return false;
+				}
+				return true;
+			}
+			/**
+			* build the tree from sorted, unique values in O(n) without comparing keys.
+			* the tree must be empty. nodes come from one contiguous run in value
+			*   order and are linked into a tree split at the middle; all nodes are
+			*   black except the deepest level, which is red unless it is the root.
+			*/
+			template<class V>
+			void buildSorted(const vector<V> &values)
+			{
+				buildSorted(values.size(), [&values](size_t i) -> const V & { return values[i]; });
+			}
+			// the same for the n pairs at(0), ..., at(n - 1)
+			template<class At>
+			void buildSorted(size_t n, At at)
+			{
+				if (n == 0)
+					return;
+				char *run = static_cast<char*>(nodePool.allocate_run(n));
+				size_t i = 0;
+				try {
+					for (; i < n; i++)
+					{
+						Node *p = new (run + i * nodePool.block_size()) Node(BLACK);
+						new (&p->storage) value_type(at(i).first, at(i).second);
+					}
+				}
+				catch (...) {
+					while (i-- > 0)
+						runNode(run, i)->value().~value_type();
+					throw;
+				}
+				int redDepth = 0;
+				while ((size_t(2) << redDepth) <= n)
+					redDepth++;
+				setRoot(linkSorted(run, 0, n, &header, 0, redDepth));
+				header.left = runNode(run, 0);
+				header.right = runNode(run, n - 1);
+				_size = n;
+				counted = true;
+			}
+			/**
+			* build the tree, which must be empty, from the n pairs order points
+			*   to: they are sorted here by key and the first of equal keys kept,
+			*   as when inserting one by one.
+			*/
+			template<class It>
+			void buildFrom(It *order, size_t n)
+			{
+				std::stable_sort(order, order + n, [this](const It &a, const It &b) {
+					return comp((*a).first, (*b).first);
+				});
+				size_t k = 0;
+				for (size_t i = 0; i < n; i++)
+				{
+					if (k == 0 || comp((*order[k - 1]).first, (*order[i]).first))
+						order[k++] = order[i];
+				}
+				buildSorted(k, [order](size_t i) -> decltype(**order) { return *order[i]; });
+			}
+			/**
+			* make this tree a copy of other without recursion.
+			* the nodes this tree already has are recycled and the rest come from
+			*   one contiguous run; structure and colours are copied in a single
+			*   preorder walk that moves through both trees in step.
+			* if copying a value throws, this tree is left empty.
+			*/
+			void assign(const RBTree &other)
+			{
+				size_t reuse = recycle();
+				size_t n = other.size();
+				if (n == 0)
+					return;
+				char *run = NULL;
+				if (n > reuse)
+					run = static_cast<char*>(nodePool.allocate_run(n - reuse));
+				size_t i = 0;
+				try {
+					const Node *sNode = other.root();
+					Node *cNode = copyOf(sNode, i < reuse ? nodePool.allocate() : runNode(run, i - reuse));
+					i++;
+					cNode->setParent(&header);
+					setRoot(cNode);
+					while (true)
+					{
+						const Node *sNext = NULL;
+						if (sNode->left != NULL && cNode->left == NULL)
+						{
+							sNext = sNode->left;
+							cNode->left = copyOf(sNext, i < reuse ? nodePool.allocate() : runNode(run, i - reuse));
+							cNode->left->setParent(cNode);
+							cNode = cNode->left;
+						}
+						else if (sNode->right != NULL && cNode->right == NULL)
+						{
+							sNext = sNode->right;
+							cNode->right = copyOf(sNext, i < reuse ? nodePool.allocate() : runNode(run, i - reuse));
+							cNode->right->setParent(cNode);
+							cNode = cNode->right;
 						}
-					} // end while
-				} // end else
-				if (cNode)
+						if (sNext != NULL)
+						{
+							i++;
+							sNode = sNext;
+							continue;
+						}
+						// both subtrees done, climb back up
+						if (sNode == other.root())
+							break;
+						sNode = sNode->getParent();
+						cNode = cNode->getParent();
+					}
+				}
+				catch (...) {
+					recycle();
+					throw;
+				}
+				header.left = leftmost(root());
+				header.right = rightmost(root());
+				_size = n;
+				counted = true;
+			}
+			/**
+			* a tree hanging off no header: its root, black unless NULL, and its
+			*   black height, counting the root. the root's parent link is stale
+			*   until the subtree is settled or joined.
+			*/
+			class subtree {
+			public:
+				subtree(Node *root = NULL, int bh = 0) : root(root), bh(bh) {}
+				Node *root;
+				int bh;
+			};
+			/**
+			* join-based algorithms: everything is built from split() and
+			*   join(), which work on detached subtrees and borrow the header of
+			*   this tree as the parent of the root while they rebalance.
+			* they relink nodes and never allocate or copy a value.
+			*/
+			// the whole tree as a subtree, and the tree left empty
+			subtree take()
+			{
+				subtree t(root(), blackHeight(root()));
+				setRoot(NULL);
+				header.left = header.right = &header;
+				_size = 0;
+				counted = true;
+				return t;
+			}
+			// make t the whole tree, the size is up to the caller
+			void settle(subtree t)
+			{
+				setRoot(t.root);
+				if (t.root == NULL)
+				{
+					header.left = header.right = &header;
+					return;
+				}
+				t.root->setParent(&header);
+				header.left = leftmost(t.root);
+				header.right = rightmost(t.root);
+			}
+			/**
+			* the tree of l, then k, then r, where the keys of l are less than
+			*   k's and the keys of r greater. O(|l.bh - r.bh| + 1).
+			* k goes down the facing spine of the taller side to the first black
+			*   node as high as the other side, takes that node and the other
+			*   side as its children, and the red links are fixed upward as
+			*   after an insert.
+			*/
+			subtree join(subtree l, Node *k, subtree r)
+			{
+				if (l.bh == r.bh)
+				{
+					attach(k, l.root, r.root);
+					k->setType(BLACK);
+					if (Augment::enabled)
+						Augment::update(k);
+					return subtree(k, l.bh + 1);
+				}
+				k->setType(RED);
+				if (l.bh > r.bh)
 				{
-					if (cNode->type != NIL)
-						cNode->type = BLACK;
+					setRoot(l.root);
+					l.root->setParent(&header);
+					Node *pNode = NULL, *cNode = l.root;
+					for (int h = l.bh; h > r.bh || isRed(cNode); cNode = cNode->right)
+					{
+						if (!isRed(cNode))
+							h--;
+						pNode = cNode;
+					}
+					attach(k, cNode, r.root);
+					k->setParent(pNode);
+					pNode->right = k;
+				}
+				else
+				{
+					setRoot(r.root);
+					r.root->setParent(&header);
+					Node *pNode = NULL, *cNode = r.root;
+					for (int h = r.bh; h > l.bh || isRed(cNode); cNode = cNode->left)
+					{
+						if (!isRed(cNode))
+							h--;
+						pNode = cNode;
+					}
+					attach(k, l.root, cNode);
+					k->setParent(pNode);
+					pNode->left = k;
+				}
+				updatePath(k);
+				int bh = l.bh > r.bh ? l.bh : r.bh;
+				if (insert_fixed_up(k))
+					bh++;
+				return subtree(root(), bh);
+			}
+			// join without a middle node: the largest node of l takes its place
+			subtree join(subtree l, subtree r)
+			{
+				if (l.root == NULL)
+					return r;
+				if (r.root == NULL)
+					return l;
+				setRoot(l.root);
+				l.root->setParent(&header);
+				header.left = header.right = &header;
+				Node *last = rightmost(l.root);
+				unlink(last);
+				return join(subtree(root(), blackHeight(root())), last, r);
+			}
+			/**
+			* cut t at key: l gets the keys less than key, r the greater ones and
+			*   mid the node holding key, detached, or NULL.
+			* O(log n): the joins on the way back up cost the differences of
+			*   the black heights they join, which add up to the height of t.
+			*/
+			template<class K>
+			void split(subtree t, const K &key, subtree &l, Node *&mid, subtree &r)
+			{
+				if (t.root == NULL)
+				{
+					l = r = subtree();
+					mid = NULL;
+					return;
+				}
+				Node *x = t.root;
+				subtree a = detach(x->left, t.bh - 1), b = detach(x->right, t.bh - 1);
+				if (comp(key, x->value().first))
+				{
+					split(a, key, l, mid, r);
+					r = join(r, x, b);
+				}
+				else if (comp(x->value().first, key))
+				{
+					split(b, key, l, mid, r);
+					l = join(a, x, l);
+				}
+				else
+				{
+					l = a;
+					r = b;
+					mid = x;
+				}
+			}
+			/**
+			* the union of a, from this tree, and b: split a at the root of b,
+			*   unite the halves with its subtrees and join them around it.
+			*   O(m log(n / m + 1)) for sizes m <= n.
+			* on equal keys the node of a stays; the one of b is appended to the
+			*   list ending at dups, chained in key order through right links.
+			*/
+			subtree unite(subtree a, subtree b, Node **&dups, size_t &dupCount)
+			{
+				if (b.root == NULL)
+					return a;
+				if (a.root == NULL)
+					return b;
+				Node *x = b.root;
+				// a single node is inserted with one descent, cheaper than a split
+				if (x->left == NULL && x->right == NULL)
+					return insertInto(a, x, dups, dupCount);
+				subtree bl = detach(x->left, b.bh - 1), br = detach(x->right, b.bh - 1);
+				subtree l, r;
+				Node *mid;
+				split(a, x->value().first, l, mid, r);
+				l = unite(l, bl, dups, dupCount);
+				if (mid != NULL)
+				{
+					*dups = x;
+					dups = &x->right;
+					dupCount++;
+				}
+				r = unite(r, br, dups, dupCount);
+				if (mid == NULL)
+					return join(l, x, r);
+				return join(l, mid, r);
+			}
+			/**
+			* unite() with the top forks levels of the recursion run in parallel:
+			*   the right halves go to a new thread, which borrows the header of
+			*   a tree of its own and chains its duplicates on a list of its own,
+			*   spliced in after those of the left halves. halves too small to be
+			*   worth a thread are united on this one.
+			*/
+			subtree uniteParallel(subtree a, subtree b, Node **&dups, size_t &dupCount, int forks)
+			{
+				if (forks <= 0 || a.bh < FORK_BH || b.bh < FORK_BH)
+					return unite(a, b, dups, dupCount);
+				Node *x = b.root;
+				subtree bl = detach(x->left, b.bh - 1), br = detach(x->right, b.bh - 1);
+				subtree l, r;
+				Node *mid;
+				split(a, x->value().first, l, mid, r);
+				RBTree scratch;
+				scratch.comp = comp;
+				Node *rDups = NULL, **rTail = &rDups;
+				size_t rCount = 0;
+				std::exception_ptr err;
+				std::thread th = spawn([&]() {
+					try {
+						r = scratch.uniteParallel(r, br, rTail, rCount, forks - 1);
+					}
+					catch (...) {
+						err = std::current_exception();
+					}
+				});
+				try {
+					l = uniteParallel(l, bl, dups, dupCount, forks - 1);
+				}
+				catch (...) {
+					if (th.joinable())
+						th.join();
+					scratch.setRoot(NULL);
+					throw;
+				}
+				if (th.joinable())
+					th.join();
+				// the nodes there belong to this tree
+				scratch.setRoot(NULL);
+				if (err)
+					std::rethrow_exception(err);
+				if (mid != NULL)
+				{
+					*dups = x;
+					dups = &x->right;
+					dupCount++;
+				}
+				if (rDups != NULL)
+				{
+					*dups = rDups;
+					dups = rTail;
+					dupCount += rCount;
+				}
+				if (mid == NULL)
+					return join(l, x, r);
+				return join(l, mid, r);
+			}
+			subtree insertInto(subtree a, Node *x, Node **&dups, size_t &dupCount)
+			{
+				setRoot(a.root);
+				a.root->setParent(&header);
+				header.left = header.right = &header;
+				Node *pNode;
+				bool toLeft;
+				if (locate(x->value().first, pNode, toLeft) != NULL)
+				{
+					*dups = x;
+					dups = &x->right;
+					dupCount++;
+					return a;
+				}
+				x->setType(RED);
+				x->setParent(pNode);
+				if (toLeft)
+					pNode->left = x;
+				else
+					pNode->right = x;
+				updatePath(x);
+				if (insert_fixed_up(x))
+					a.bh++;
+				return subtree(root(), a.bh);
+			}
+			// the nodes of a whose key is in the tree under b, the rest freed
+			subtree intersect(subtree a, const Node *b, size_t &kept)
+			{
+				if (a.root == NULL)
+					return a;
+				if (b == NULL)
+				{
+					freeTree(a.root);
+					return subtree();
+				}
+				subtree l, r;
+				Node *mid;
+				split(a, b->value().first, l, mid, r);
+				l = intersect(l, b->left, kept);
+				r = intersect(r, b->right, kept);
+				if (mid == NULL)
+					return join(l, r);
+				kept++;
+				return join(l, mid, r);
+			}
+			// the nodes of a whose key is not in the tree under b, the rest freed
+			subtree subtract(subtree a, const Node *b, size_t &removed)
+			{
+				if (a.root == NULL || b == NULL)
+					return a;
+				subtree l, r;
+				Node *mid;
+				split(a, b->value().first, l, mid, r);
+				l = subtract(l, b->left, removed);
+				r = subtract(r, b->right, removed);
+				if (mid != NULL)
+				{
+					freeNode(mid);
+					removed++;
+				}
+				return join(l, r);
+			}
+			/**
+			* apply the n operations ops points to, sorted by key with equal keys
+			*   in batch order, to a: a is split at the key in the middle of the
+			*   batch, the operations on it are applied to the node found there,
+			*   the two sides get the rest alike and are joined back, so the
+			*   batch costs O(m log(n / m + 1)) for m <= n operations.
+			* if an operation throws, a is joined back whole with the operations
+			*   before it applied, and inserted / erased count them.
+			*/
+			void applyBatch(subtree &a, batch_op **ops, size_t n, size_t &inserted, size_t &erased)
+			{
+				if (n == 0)
+					return;
+				// a few operations cost a descent each, cheaper than splits
+				if (a.root != NULL && n < static_cast<size_t>(a.bh))
+				{
+					while (n > 0 && a.root != NULL)
+					{
+						a = applyOp(a, **ops, inserted, erased);
+						ops++;
+						n--;
+					}
+					if (n == 0)
+						return;
+				}
+				size_t lo = n / 2, hi = lo + 1;
+				const Key &key = ops[lo]->key;
+				while (lo > 0 && !comp(ops[lo - 1]->key, key))
+					lo--;
+				while (hi < n && !comp(key, ops[hi]->key))
+					hi++;
+				subtree l, r;
+				Node *mid;
+				split(a, key, l, mid, r);
+				try {
+					applyBatch(l, ops, lo, inserted, erased);
+					for (size_t i = lo; i < hi; i++)
+						mid = applyOp(mid, *ops[i], inserted, erased);
+					applyBatch(r, ops + hi, n - hi, inserted, erased);
+				}
+				catch (...) {
+					a = mid == NULL ? join(l, r) : join(l, mid, r);
+					throw;
+				}
+				a = mid == NULL ? join(l, r) : join(l, mid, r);
+			}
+			// op on the subtree a, which is changed only if op succeeds
+			subtree applyOp(subtree a, batch_op &op, size_t &inserted, size_t &erased)
+			{
+				setRoot(a.root);
+				a.root->setParent(&header);
+				header.left = header.right = &header;
+				Node *pNode;
+				bool toLeft;
+				Node *p = locate(op.key, pNode, toLeft);
+				if (p != NULL)
+				{
+					if (op.kind == batch_op::ERASE)
+					{
+						unlink(p);
+						freeNode(p);
+						erased++;
+						a = subtree(root(), blackHeight(root()));
+					}
 					else
-						cNode->type = NIL;
+					{
+						p->value().second = op.value;
+						updatePath(p);
+					}
+					op.result = op.kind == batch_op::ERASE;
+					return a;
+				}
+				op.result = op.kind == batch_op::UPSERT;
+				if (op.kind == batch_op::ERASE)
+					return a;
+				Node *x = newNode(op.key, op.value);
+				x->setParent(pNode);
+				if (toLeft)
+					pNode->left = x;
+				else
+					pNode->right = x;
+				updatePath(x);
+				inserted++;
+				if (insert_fixed_up(x))
+					a.bh++;
+				return subtree(root(), a.bh);
+			}
+			// op on p, the detached node of its key or NULL; returns what is left
+			Node* applyOp(Node *p, batch_op &op, size_t &inserted, size_t &erased)
+			{
+				if (op.kind == batch_op::ERASE)
+				{
+					op.result = p != NULL;
+					if (p != NULL)
+					{
+						freeNode(p);
+						erased++;
+					}
+					return NULL;
+				}
+				if (p != NULL)
+				{
+					p->value().second = op.value;
+					op.result = false;
+					return p;
+				}
+				p = newNode(op.key, op.value);
+				op.result = true;
+				inserted++;
+				return p;
+			}
+			/**
+			* whole-tree operations. nodes coming from other make both trees
+			*   share one pool, since they may outlive other.
+			*/
+			// move the keys not less than key into other, which must be empty
+			template<class K>
+			void splitOff(const K &key, RBTree &other)
+			{
+				nodePool.share(other.nodePool);
+				subtree l, r;
+				Node *mid;
+				split(take(), key, l, mid, r);
+				if (mid != NULL)
+					r = join(subtree(), mid, r);
+				settle(l);
+				other.settle(r);
+				counted = other.counted = false;
+				leaveIfEmpty();
+				other.leaveIfEmpty();
+			}
+			// append other, whose keys are all greater than the ones here
+			void append(RBTree &other)
+			{
+				if (this == &other || other.root() == NULL)
+					return;
+				nodePool.share(other.nodePool);
+				bool known = counted && other.counted;
+				size_t n = _size + other._size;
+				subtree r = other.take();
+				settle(join(take(), r));
+				_size = n;
+				counted = known;
+				other.leaveIfEmpty();
+			}
+			/**
+			* move the nodes of other into this tree. where both have a key the
+			*   node of this tree stays, and the one of other goes back into
+			*   other if keepDuplicates, or is freed.
+			*/
+			void unite(RBTree &other, bool keepDuplicates, unsigned threads = 1)
+			{
+				if (this == &other || other.root() == NULL)
+					return;
+				nodePool.share(other.nodePool);
+				bool known = counted && other.counted;
+				size_t n = _size + other._size;
+				Node *dups = NULL, **tail = &dups;
+				size_t dupCount = 0;
+				subtree b = other.take();
+				settle(uniteParallel(take(), b, tail, dupCount, forksFor(threads)));
+				*tail = NULL;
+				_size = n - dupCount;
+				counted = known;
+				if (keepDuplicates)
+				{
+					// they come sorted, so other is rebuilt in O(k)
+					int redDepth = 0;
+					while ((size_t(2) << redDepth) <= dupCount)
+						redDepth++;
+					other.setRoot(linkList(dups, dupCount, &other.header, 0, redDepth));
+					other.settle(subtree(other.root()));
+					other._size = dupCount;
+					other.leaveIfEmpty();
+					return;
+				}
+				while (dups != NULL)
+				{
+					Node *p = dups;
+					dups = p->right;
+					freeNode(p);
 				}
+				other.leaveIfEmpty();
 			}
-
-			void leftRotate(Node*& parent)
+			// apply the n operations ops points to, sorted as for applyBatch()
+			void applyBatch(batch_op **ops, size_t n)
 			{
-				Node* subR = parent->right;
-				Node* subRL = subR->left;
-
-				parent->right = subRL;
-				if (subRL)
-				{
-					subRL->parent = parent;
+				bool known = counted;
+				size_t size = _size, inserted = 0, erased = 0;
+				subtree a = take();
+				try {
+					applyBatch(a, ops, n, inserted, erased);
 				}
-
-				subR->left = parent;
-				subR->parent = parent->parent;
-				parent->parent = subR;
-				parent = subR;
-
-				if (parent->parent == NULL)
-				{
-					root = parent;
+				catch (...) {
+					settle(a);
+					_size = size + inserted - erased;
+					counted = known;
+					throw;
+				}
+				settle(a);
+				_size = size + inserted - erased;
+				counted = known;
+				leaveIfEmpty();
+			}
+			/**
+			* insert the n pairs from first, the first of equal keys winning as
+			*   when inserting one by one. the input is cut into a part per
+			*   thread, each part sorted and built into a tree of its own on its
+			*   own thread, and the parts united into this tree in input order.
+			*/
+			template<class It>
+			void insertParallel(It first, size_t n, unsigned threads)
+			{
+				if (n == 0)
+					return;
+				size_t parts = threads < n ? threads : n;
+				It *order = new It[n];
+				RBTree *part = NULL;
+				std::exception_ptr *err = NULL;
+				std::thread *th = NULL;
+				try {
+					for (size_t i = 0; i < n; i++, ++first)
+						order[i] = first;
+					part = new RBTree[parts];
+					err = new std::exception_ptr[parts];
+					th = new std::thread[parts];
+				}
+				catch (...) {
+					delete[] err;
+					delete[] part;
+					delete[] order;
+					throw;
 				}
-				else if (parent->parent->left == parent->left)
+				for (size_t j = 0; j < parts; j++)
 				{
-					parent->parent->left = parent;
+					size_t lo = n * j / parts, hi = n * (j + 1) / parts;
+					part[j].comp = comp;
+					th[j] = spawn([=]() {
+						try {
+							part[j].buildFrom(order + lo, hi - lo);
+						}
+						catch (...) {
+							err[j] = std::current_exception();
+						}
+					});
 				}
-				else if (parent->parent->right == parent->left)
+				for (size_t j = 0; j < parts; j++)
 				{
-					parent->parent->right = parent;
+					if (th[j].joinable())
+						th[j].join();
+				}
+				delete[] th;
+				delete[] order;
+				try {
+					for (size_t j = 0; j < parts; j++)
+					{
+						if (err[j])
+							std::rethrow_exception(err[j]);
+					}
+					for (size_t j = 0; j < parts; j++)
+						unite(part[j], false, threads);
+				}
+				catch (...) {
+					delete[] err;
+					delete[] part;
+					throw;
 				}
+				delete[] err;
+				delete[] part;
 			}
-
-			void rightRotate(Node*& parent)
+			// keep the keys other has too
+			void intersect(const RBTree &other)
 			{
-				Node* subL = parent->left;
-				Node* subLR = subL->right;
-
-				parent->left = subLR;
-				if (subLR)
+				if (this == &other)
+					return;
+				size_t kept = 0;
+				settle(intersect(take(), other.root(), kept));
+				_size = kept;
+				counted = true;
+				leaveIfEmpty();
+			}
+			// drop the keys other has
+			void subtract(const RBTree &other)
+			{
+				if (this == &other)
 				{
-					subLR->parent = parent;
+					clear();
+					return;
 				}
-
-				subL->right = parent;
-				subL->parent = parent->parent;
-				parent->parent = subL;
-
-				parent = subL;
-
-				if (parent->parent == NULL)
+				bool known = counted;
+				size_t n = _size, removed = 0;
+				settle(subtract(take(), other.root(), removed));
+				_size = n - removed;
+				counted = known;
+				leaveIfEmpty();
+			}
+			// key order of the last key here against the first of other
+			bool precedes(const RBTree &other) const
+			{
+				return root() == NULL || other.root() == NULL || comp(header.right->value().first, other.header.left->value().first);
+			}
+		private:
+			static int blackHeight(const Node *p)
+			{
+				int h = 0;
+				for (; p != NULL; p = p->left)
 				{
-					root = parent;
+					if (p->getType() == BLACK)
+						h++;
 				}
-				else if (parent->parent->left == parent->right)
-				{
-					parent->parent->left = parent;
+				return h;
+			}
+			// fork uniteParallel() only where both sides have this black height
+			static const int FORK_BH = 10;
+			// the levels to fork for up to threads threads in all
+			static int forksFor(unsigned threads)
+			{
+				int forks = 0;
+				while (forks < 16 && (1u << forks) < threads)
+					forks++;
+				return forks;
+			}
+			// run task on a new thread, or on this one if none can be started
+			template<class F>
+			static std::thread spawn(F task)
+			{
+				try {
+					return std::thread(task);
 				}
-				else if (parent->parent->right == parent->right)
+				catch (...) {
+					task();
+					return std::thread();
+				}
+			}
+			// the child c of a node of black height bh, detached and made black
+			static subtree detach(Node *c, int bh)
+			{
+				if (c != NULL && c->getType() == RED)
 				{
-					parent->parent->right = parent;
+					c->setType(BLACK);
+					bh++;
 				}
+				return subtree(c, bh);
 			}
-
-			Node *sibling(Node* cNode)
+			static void attach(Node *k, Node *l, Node *r)
+			{
+				k->left = l;
+				k->right = r;
+				if (l != NULL)
+					l->setParent(k);
+				if (r != NULL)
+					r->setParent(k);
+			}
+			/**
+			* the next n nodes of a sorted list chained through right links, as
+			*   a tree split at the middle and coloured as by buildSorted().
+			*/
+			static Node* linkList(Node *&list, size_t n, Node *parent, int depth, int redDepth)
 			{
-				if (cNode == NULL || cNode->parent == NULL)
+				if (n == 0)
 					return NULL;
-				if (cNode == cNode->parent->left)
-					return cNode->parent->right;
-				else
-					return cNode->parent->left;
+				Node *l = linkList(list, n / 2, NULL, depth + 1, redDepth);
+				Node *p = list;
+				list = list->right;
+				p->setParent(parent);
+				p->setType(depth == redDepth && depth > 0 ? RED : BLACK);
+				p->left = l;
+				if (l != NULL)
+					l->setParent(p);
+				p->right = linkList(list, n - n / 2 - 1, p, depth + 1, redDepth);
+				if (Augment::enabled)
+					Augment::update(p);
+				return p;
 			}
-		public:
-			void copyTree(RBTree *t)
+		private:
+			Node* runNode(char *run, size_t i)
 			{
-				if (t == NULL || t->root == NULL)
-					return;
-				copyNode(root, t->root);
-				_size = t->size();
+				return reinterpret_cast<Node*>(run + i * nodePool.block_size());
 			}
-			void copyTree(Node *rt)
+			Node* linkSorted(char *run, size_t lo, size_t hi, Node *parent, int depth, int redDepth)
 			{
-				if (rt == NULL)
-					return;
-				copyNode(root, rt);
+				if (lo >= hi)
+					return NULL;
+				size_t mid = lo + (hi - lo) / 2;
+				Node *p = runNode(run, mid);
+				p->setParent(parent);
+				if (depth == redDepth && depth > 0)
+					p->setType(RED);
+				p->left = linkSorted(run, lo, mid, p, depth + 1, redDepth);
+				p->right = linkSorted(run, mid + 1, hi, p, depth + 1, redDepth);
+				if (Augment::enabled)
+					Augment::update(p);
+				return p;
 			}
-		private:
-			void copyNode(Node *&t, Node *&r)
+			// a detached copy of r's value and colour, built in the block mem
+			Node* copyOf(const Node *r, void *mem)
 			{
-				if (r != NULL)
+				Node *p = new (mem) Node(r->getType());
+				static_cast<typename Augment::data&>(*p) = static_cast<const typename Augment::data&>(*r);
+				try {
+					new (&p->storage) value_type(r->value());
+				}
+				catch (...) {
+					nodePool.deallocate(p);
+					throw;
+				}
+				return p;
+			}
+			/**
+			* empty the tree but keep its memory: every node is destroyed and goes
+			*   back to the pool's free list, leaves first, without recursion.
+			* returns how many nodes were freed.
+			*/
+			size_t recycle()
+			{
+				size_t count = 0;
+				Node *p = root();
+				while (p != NULL)
 				{
-					if(!t)
-						t = new Node(r);
-					if (r->type != NIL)
+					if (p->left != NULL)
 					{
-						copyNode(t->left, r->left);
-						t->left->parent = t;
-						copyNode(t->right, r->right);
-						t->right->parent = t;
+						p = p->left;
+						continue;
 					}
+					if (p->right != NULL)
+					{
+						p = p->right;
+						continue;
+					}
+					Node *pNode = p->getParent();
+					if (pNode == &header)
+						pNode = NULL;
+					else if (pNode->left == p)
+						pNode->left = NULL;
+					else
+						pNode->right = NULL;
+					freeNode(p);
+					count++;
+					p = pNode;
 				}
+				setRoot(NULL);
+				header.left = header.right = &header;
+				_size = 0;
+				counted = true;
+				return count;
 			}
 
 			void clearNode(Node *p)
@@ -627,11 +2053,166 @@ namespace sjtu {
 					clearNode(p->left);
 				if (p->right)
 					clearNode(p->right);
-				delete p;
+				p->value().~value_type();
+			}
+			// destroy and free every node under p
+			// returns how many nodes were freed
+			size_t freeTree(Node *p)
+			{
+				size_t n = 1;
+				if (p->left)
+					n += freeTree(p->left);
+				if (p->right)
+					n += freeTree(p->right);
+				freeNode(p);
+				return n;
+			}
+			static size_t countNodes(Node *p, std::true_type)
+			{
+				return Augment::count(p);
+			}
+			static size_t countNodes(Node *p, std::false_type)
+			{
+				size_t n = 0;
+				if (p != NULL)
+				{
+					for (p = leftmost(p); p->getType() != NIL; p = nextNode(p))
+						n++;
+				}
+				return n;
 			}
 
+			template<class... Args>
+			Node* newNode(Args&&... args)
+			{
+				Node *p = new (nodePool.allocate()) Node(RED);
+				try {
+					new (&p->storage) value_type(std::forward<Args>(args)...);
+				}
+				catch (...) {
+					nodePool.deallocate(p);
+					throw;
+				}
+				return p;
+			}
+			void freeNode(Node *p)
+			{
+				p->value().~value_type();
+				p->~Node();
+				nodePool.deallocate(p);
+			}
+		};
+		/**
+		* a node handle: owns an element taken out of a map by extract(), to
+		*   be put into a map of the same type by insert() without allocating
+		*   or copying anything. key() and mapped() throw container_is_empty
+		*   on an empty handle.
+		* the handle holds a share of the pool its node came from (see
+		*   shared_slab_pool), so the node stays valid if that map goes first;
+		*   while it does, that map allocates under the pool's lock.
+		*/
+		class node_type {
+			friend class map;
+		public:
+			node_type() : nd(NULL) {}
+			node_type(node_type &&other) : nd(NULL)
+			{
+				take(other);
+			}
+			node_type & operator=(node_type &&other)
+			{
+				if (this != &other)
+				{
+					reset();
+					take(other);
+				}
+				return *this;
+			}
+			node_type(const node_type &other) = delete;
+			node_type & operator=(const node_type &other) = delete;
+			~node_type()
+			{
+				reset();
+			}
+			bool empty() const
+			{
+				return nd == NULL;
+			}
+			explicit operator bool() const
+			{
+				return nd != NULL;
+			}
+			const Key & key() const
+			{
+				if (nd == NULL)
+					throw container_is_empty();
+				return nd->value().first;
+			}
+			T & mapped() const
+			{
+				if (nd == NULL)
+					throw container_is_empty();
+				return nd->value().second;
+			}
+		private:
+			void take(node_type &other)
+			{
+				if (other.nd != NULL)
+				{
+					pool.enter(other.pool);
+					other.pool.leave();
+				}
+				nd = other.nd;
+				other.nd = NULL;
+			}
+			// destroy the element, if any, and let go of the pool
+			void reset()
+			{
+				if (nd != NULL)
+				{
+					nd->value().~value_type();
+					nd->~Node();
+					pool.deallocate(nd);
+					nd = NULL;
+				}
+				pool.leave();
+			}
+			Node *nd;
+			shared_slab_pool<sizeof(Node), alignof(Node)> pool;
+		};
+		/**
+		* what operator[] returns under the aggregate augmentation, in place
+		*   of T &: it reads as const T & and an assignment through it
+		*   refreshes the totals above the element.
+		*/
+		class mapped_ref {
+			friend class map;
+		public:
+			operator const T &() const {
+				return p->value().second;
+			}
+			const T & get() const {
+				return p->value().second;
+			}
+			template<class M>
+			mapped_ref & operator=(M &&obj) {
+				p->value().second = std::forward<M>(obj);
+				t->refresh(p);
+				return *this;
+			}
+			mapped_ref & operator=(const mapped_ref &other) {
+				return *this = other.get();
+			}
+		private:
+			mapped_ref(RBTree *t, Node *p) : t(t), p(p) {}
+			RBTree *t;
+			Node *p;
 		};
+		// T & for most maps, mapped_ref under the aggregate augmentation
+		typedef typename std::conditional<Augment::reduces, mapped_ref, T &>::type mapped_reference;
 		class const_iterator;
+		// under the aggregate augmentation, a value changed through * or ->
+		//   leaves the totals stale until refresh() on the iterator
 		class iterator {
 		public:
 			Node* nd;
@@ -647,161 +2228,81 @@ namespace sjtu {
 			}
 			/**
 			* return a new iterator which pointer n-next elements
-			*   even if there are not enough elements, just return the answer.
+			*   throw index_out_of_bound if that is past end() or before begin().
 			* as well as operator-
+			* only with the order_statistic augmentation, each costs O(log n).
 			*/
+			iterator operator+(const int &n) const
+			{
+				return iterator(RBTree::advance(nd, n));
+			}
+			iterator operator-(const int &n) const
+			{
+				return iterator(RBTree::advance(nd, -static_cast<long>(n)));
+			}
+			iterator & operator+=(const int &n)
+			{
+				nd = RBTree::advance(nd, n);
+				return *this;
+			}
+			iterator & operator-=(const int &n)
+			{
+				nd = RBTree::advance(nd, -static_cast<long>(n));
+				return *this;
+			}
+			// return the distance between two iterators,
+			// if these two iterators points to different maps, throw invalid_iterator.
+			int operator-(const iterator &rhs) const
+			{
+				return static_cast<int>(RBTree::distance(nd, rhs.nd));
+			}
 			/**
 			* TODO iter++
 			*/
 			iterator operator++(int)
 			{
-				Node* t = this->nd;
-				Node* cNode = this->nd;
-				Node* end = getEnd();
-				if (cNode == getEnd())
-					throw index_out_of_bound();
-				if (cNode->right == end)
-				{
-					this->nd = end;
-					return iterator(end);
-				}
-				if (cNode->right->type != NIL)
-				{
-					t = cNode->right;
-					while (t->left->type != NIL)
-						t = t->left;
-					this->nd = t;
-					return iterator(cNode);
-				}
-				if (cNode->parent)
-				{
-					t = cNode->parent;
-					while (t->parent && t->type != NIL && cNode == t->right)
-					{
-						cNode = t;
-						t = t->parent;
-					}
-				}
-				if (t)
-				{
-					cNode = this->nd;
-					this->nd = t;
-					return iterator(cNode);
-				}
-				else
-					throw index_out_of_bound();
+				iterator tmp(*this);
+				++*this;
+				return tmp;
 			}
 			/**
 			* TODO ++iter
 			*/
 			iterator & operator++()
 			{
-				Node* t = this->nd;
-				Node* cNode = this->nd;
-				Node* end = getEnd();
-				if (cNode == end)
-					throw index_out_of_bound();
-				if (cNode->right == end)
-				{
-					this->nd = end;
-					return *this;
-				}
-				if (cNode->right->type != NIL)
-				{
-					t = cNode->right;
-					while (t->left->type != NIL)
-						t = t->left;
-					this->nd = t;
-					return *this;
-				}
-				if (cNode->parent)
-				{
-					t = cNode->parent;
-					while (t->type != NIL && cNode == t->right)
-					{
-						cNode = t;
-						t = t->parent;
-					}
-				}
-				this->nd = t;
-				if (t->type != NIL)
-					return *this;
-				else
+				if (nd == NULL || nd->getType() == NIL)
 					throw index_out_of_bound();
+				nd = RBTree::nextNode(nd);
+				return *this;
 			}
 			/**
 			* TODO iter--
 			*/
 			iterator operator--(int)
 			{
-				Node* t = this->nd;
-				Node* cNode = this->nd;
-				Node* begin = getBegin();
-				if (cNode == begin)
-					throw index_out_of_bound();
-				if (cNode->left && cNode->left->type != NIL)
-				{
-					t = cNode->left;
-					while (t->right->type != NIL)
-						t = t->right;
-					this->nd = t;
-					return iterator(cNode);
-				}
-				if (cNode->parent)
-				{
-					t = cNode->parent;
-					while (t->type != NIL && cNode == t->left)
-					{
-						cNode = t;
-						t = t->parent;
-					}
-				}
-				cNode = this->nd;
-				this->nd = t;
-				if (t->type != NIL)
-					return iterator(cNode);
-				else
-					throw index_out_of_bound();
+				iterator tmp(*this);
+				--*this;
+				return tmp;
 			}
 			/**
 			* TODO --iter
 			*/
 			iterator & operator--()
 			{
-				Node* t = this->nd;
-				Node* cNode = this->nd;
-				Node* begin = getBegin();
-				if (cNode == begin)
+				if (nd == NULL)
 					throw index_out_of_bound();
-				if (cNode->left && cNode->left->type != NIL)
-				{
-					t = cNode->left;
-					while (t->right->type != NIL)
-						t = t->right;
-					this->nd = t;
-					return *this;
-				}
-				if (cNode->parent)
-				{
-					t = cNode->parent;
-					while (t->type != NIL && cNode == t->left)
-					{
-						cNode = t;
-						t = t->parent;
-					}
-				}
-				this->nd = t;
-				if (t->type != NIL)
-					return *this;
-				else
+				Node *p = RBTree::prevNode(nd);
+				if (p == NULL)
 					throw index_out_of_bound();
+				nd = p;
+				return *this;
 			}
 			/**
 			* a operator to check whether two iterators are same (pointing to the same memory).
 			*/
 			value_type & operator*() const
 			{
-				return *nd->vt;
+				return nd->value();
 			}
 			bool operator==(const iterator &rhs) const
 			{
@@ -828,45 +2329,12 @@ namespace sjtu {
 			* See <http://kelvinh.github.io/blog/2013/11/20/overloading-of-member-access-operator-dash-greater-than-symbol-in-cpp/> for help.
 			*/
 			value_type* operator->() const noexcept {
-				return nd->vt;
+				return &nd->value();
 			}
 			iterator& operator=(const iterator &rhs) {
 				nd = rhs.nd;
 				return *this;
 			}
-		private:
-			Node* getRoot()
-			{
-				Node *p = nd;
-				if (p)
-				{
-					while (p->parent)
-					{
-						p = p->parent;
-					}
-				}
-				return p;
-			}
-			Node* getBegin()
-			{
-				Node *r = getRoot();
-				while (r->left)
-				{
-					r = r->left;
-				}
-				if (r)
-					r = r->parent;
-				return r;
-			}
-			Node* getEnd()
-			{
-				Node *r = getRoot();
-				while (r->right)
-				{
-					r = r->right;
-				}
-				return r;
-			}
 		};
 		class const_iterator {
 			// it should has similar member method as iterator.
@@ -875,7 +2343,7 @@ namespace sjtu {
 			const Node* nd;
 		public:
 			const_iterator() {
-				nd == NULL;
+				nd = NULL;
 			}
 			const_iterator(const Node* nd) {
 				this->nd = nd;
@@ -886,202 +2354,84 @@ namespace sjtu {
 			const_iterator(const iterator &other) {
 				nd = other.nd;
 			}
+			const_iterator operator+(const int &n) const
+			{
+				return const_iterator(RBTree::advance(const_cast<Node*>(nd), n));
+			}
+			const_iterator operator-(const int &n) const
+			{
+				return const_iterator(RBTree::advance(const_cast<Node*>(nd), -static_cast<long>(n)));
+			}
+			const_iterator & operator+=(const int &n)
+			{
+				nd = RBTree::advance(const_cast<Node*>(nd), n);
+				return *this;
+			}
+			const_iterator & operator-=(const int &n)
+			{
+				nd = RBTree::advance(const_cast<Node*>(nd), -static_cast<long>(n));
+				return *this;
+			}
+			int operator-(const const_iterator &rhs) const
+			{
+				return static_cast<int>(RBTree::distance(const_cast<Node*>(nd), const_cast<Node*>(rhs.nd)));
+			}
 			const_iterator& operator=(const const_iterator &other) {
 				nd = other.nd;
 				return *this;
 			}
-			bool operator!=(const const_iterator &other) {
+			bool operator!=(const const_iterator &other) const {
 				return nd != other.nd;
 			}
-			bool operator==(const const_iterator &other) {
+			bool operator==(const const_iterator &other) const {
 				return nd == other.nd;
 			}
-			value_type* operator->() {
-				return nd->vt;
+			const value_type* operator->() const {
+				return &nd->value();
 			}
-			value_type & operator*() const
+			const value_type & operator*() const
 			{
-				return *nd->vt;
+				return nd->value();
 			}
 
 			const_iterator operator++(int)
 			{
-				const Node* t = this->nd;
-				const Node* cNode = this->nd;
-				const Node* end = getEnd();
-				if (cNode == end)
-					throw index_out_of_bound();
-				if (cNode->right == end)
-				{
-					this->nd = end;
-					return const_iterator(end);
-				}
-				if (cNode->right->type != NIL)
-				{
-					t = cNode->right;
-					while (t->left->type != NIL)
-						t = t->left;
-					this->nd = t;
-					return const_iterator(t);
-				}
-				if (cNode->parent)
-				{
-					t = cNode->parent;
-					while (t->parent && t->type != NIL && cNode == t->right)
-					{
-						cNode = t;
-						t = t->parent;
-					}
-				}
-				if (t)
-				{
-					this->nd = t;
-					return const_iterator(t);
-				}
-				else
-					throw index_out_of_bound();
+				const_iterator tmp(*this);
+				++*this;
+				return tmp;
 			}
 			/**
 			* TODO ++iter
 			*/
 			const_iterator & operator++()
 			{
-				const Node* t = this->nd;
-				const Node* cNode = this->nd;
-				const Node* end = getEnd();
-				if (cNode == end)
-					throw index_out_of_bound();
-				if (cNode->right == end)
-				{
-					this->nd = end;
-					return *this;
-				}
-				if (cNode->right->type != NIL)
-				{
-					t = cNode->right;
-					while (t->left->type != NIL)
-						t = t->left;
-					this->nd = t;
-					return *this;
-				}
-				if (cNode->parent)
-				{
-					t = cNode->parent;
-					while (t->parent && t->type != NIL && cNode == t->right)
-					{
-						cNode = t;
-						t = t->parent;
-					}
-				}
-				if (t)
-				{
-					this->nd = t;
-					return *this;
-				}
-				else
+				if (nd == NULL || nd->getType() == NIL)
 					throw index_out_of_bound();
+				nd = RBTree::nextNode(const_cast<Node*>(nd));
+				return *this;
 			}
 			/**
 			* TODO iter--
 			*/
-			const_iterator operator--(int)
-			{
-				const Node* t = this->nd;
-				const Node* cNode = this->nd;
-				const Node* begin = getBegin();
-				if (cNode == begin)
-					throw index_out_of_bound();
-				if (cNode->left && cNode->left->type != NIL)
-				{
-					t = cNode->left;
-					while (t->right->type != NIL)
-						t = t->right;
-					this->nd = t;
-					return const_iterator(t);
-				}
-				if (cNode->parent)
-				{
-					t = cNode->parent;
-					while (t->type != NIL && cNode == t->left)
-					{
-						cNode = t;
-						t = t->parent;
-					}
-				}
-				this->nd = t;
-				if (t->type != NIL)
-					return const_iterator(t);
-				else
-					throw index_out_of_bound();
+			const_iterator operator--(int)
+			{
+				const_iterator tmp(*this);
+				--*this;
+				return tmp;
 			}
 			/**
 			* TODO --iter
 			*/
 			const_iterator & operator--()
 			{
-				const Node* t = this->nd;
-				const Node* cNode = this->nd;
-				const Node* begin = getBegin();
-				if (cNode == begin)
+				if (nd == NULL)
 					throw index_out_of_bound();
-				if (cNode->left && cNode->left->type != NIL)
-				{
-					t = cNode->left;
-					while (t->right->type != NIL)
-						t = t->right;
-					this->nd = t;
-					return *this;
-				}
-				if (cNode->parent)
-				{
-					t = cNode->parent;
-					while (t->type != NIL && cNode == t->left)
-					{
-						cNode = t;
-						t = t->parent;
-					}
-				}
-				this->nd = t;
-				if (t->type != NIL)
-					return *this;
-				else
+				const Node *p = RBTree::prevNode(const_cast<Node*>(nd));
+				if (p == NULL)
 					throw index_out_of_bound();
+				nd = p;
+				return *this;
 			}
-			const Node* getRoot()
-			{
-				const Node *p = nd;
-				if (p)
-				{
-					while (p->parent)
-					{
-						p = p->parent;
-					}
-				}
-				return p;
-			}
-			const Node* getEnd()
-			{
-				const Node *r = getRoot();
-				while (r->right)
-				{
-					r = r->right;
-				}
-				return r;
-			}
-			const Node* getBegin()
-			{
-				const Node *r = getRoot();
-				while (r->left)
-				{
-					r = r->left;
-				}
-				if (r)
-					r = r->parent;
-				return r;
-			}
-			// And other methods in iterator.
-			// And other methods in iterator.
-			// And other methods in iterator.
 		};
 		/**
 		* TODO two constructors
@@ -1090,19 +2440,60 @@ namespace sjtu {
 			t = new RBTree();
 		}
 		map(const map &other) {
+			t = new RBTree(*other.t);
+		}
+		// other is left empty
+		map(map &&other) {
+			t = other.t;
+			other.t = new RBTree();
+		}
+		/**
+		* construct from the pairs in values.
+		* costs O(n) when they are sorted by key without duplicates (see
+		*   assign_sorted), otherwise they are inserted one by one and the
+		*   first of equal keys wins.
+		*/
+		template<class V>
+		explicit map(const vector<V> &values) {
 			t = new RBTree();
-			t->copyTree(other.t);
+			if (t->isSorted(values))
+				t->buildSorted(values);
+			else
+			{
+				for (size_t i = 0; i < values.size(); i++)
+					t->insert(value_type(values[i].first, values[i].second));
+			}
 		}
 		/**
 		* TODO assignment operator
 		*/
 		map & operator=(const map &other)
 		{
-			if (!t)
-				t = new RBTree();
-			t->copyTree(other.t);
+			if (this != &other)
+				*t = *other.t;
+			return *this;
+		}
+		map & operator=(map &&other)
+		{
+			RBTree *tmp = t;
+			t = other.t;
+			other.t = tmp;
 			return *this;
 		}
+		/**
+		* replace the content with values, which must be sorted by key without
+		*   duplicates. runs in O(n) with nodes allocated as one batch.
+		* with check the order is verified first (n - 1 comparisons) and
+		*   runtime_error is thrown if it does not hold; the map is left unchanged.
+		*/
+		template<class V>
+		void assign_sorted(const vector<V> &values, bool check = true)
+		{
+			if (check && !t->isSorted(values))
+				throw runtime_error();
+			t->clear();
+			t->buildSorted(values);
+		}
 		bool operator==(const map &other)
 		{
 			return t == other.t;
@@ -1121,6 +2512,9 @@ namespace sjtu {
 		* access specified element with bounds checking
 		* Returns a reference to the mapped value of the element with key equivalent to key.
 		* If no such element exists, an exception of type `index_out_of_bound'
+		* under the aggregate augmentation, a value changed through the reference
+		*   leaves the totals stale until refresh(); operator[] or
+		*   insert_or_assign() keep them right.
 		*/
 		T & at(const Key &key)
 		{
@@ -1128,7 +2522,7 @@ namespace sjtu {
 			if (p == NULL)
 				throw index_out_of_bound();
 			else
-				return p->vt->second;
+				return p->value().second;
 		}
 		const T & at(const Key &key) const
 		{
@@ -1137,25 +2531,55 @@ namespace sjtu {
 				throw index_out_of_bound();
 			else
 			{
-				return p->vt->second;
+				return p->value().second;
 			}
 		}
 		/**
+		* with a transparent Compare (one that defines is_transparent, like
+		*   std::less<>) at, count, find, lower_bound and erase also take any
+		*   key type Compare can compare with Key, so no Key is built to look up.
+		*/
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		T & at(const K &key)
+		{
+			Node *p = t->find(key);
+			if (p == NULL)
+				throw index_out_of_bound();
+			return p->value().second;
+		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		const T & at(const K &key) const
+		{
+			Node *p = t->find(key);
+			if (p == NULL)
+				throw index_out_of_bound();
+			return p->value().second;
+		}
+		/**
 		* TODO
 		* access specified element
 		* Returns a reference to the value that is mapped to a key equivalent to key,
 		*   performing an insertion if such key does not already exist.
+		* under the aggregate augmentation the reference is a mapped_ref, whose
+		*   assignments keep range_reduce() right.
 		*/
-		T & operator[](const Key &key)
+		mapped_reference operator[](const Key &key)
 		{
-			Node *p = t->find(key);
+			Node *pNode;
+			bool toLeft;
+			Node *p = t->locate(key, pNode, toLeft);
 			if (p == NULL)
-			{
-				T dt = T();
-				t->insert(value_type(key, dt));
-				p = t->find(key);
-			}
-			return p->vt->second;
+				p = t->insertAt(pNode, toLeft, key, T());
+			return mapped(p, std::integral_constant<bool, Augment::reduces>());
+		}
+		mapped_reference operator[](Key &&key)
+		{
+			Node *pNode;
+			bool toLeft;
+			Node *p = t->locate(key, pNode, toLeft);
+			if (p == NULL)
+				p = t->insertAt(pNode, toLeft, std::move(key), T());
+			return mapped(p, std::integral_constant<bool, Augment::reduces>());
 		}
 		/**
 		* behave like at() throw index_out_of_bound if such key does not exist.
@@ -1165,7 +2589,7 @@ namespace sjtu {
 			Node *p = t->find(key);
 			if (p == NULL)
 				throw index_out_of_bound();
-			return p->vt->second;
+			return p->value().second;
 		}
 		/**
 		* return a iterator to the beginning
@@ -1206,15 +2630,27 @@ namespace sjtu {
 			return t->size();
 		}
 		/**
+		* bytes one element occupies: the size of the pool block holding its node.
+		*/
+		static size_t node_bytes()
+		{
+			return shared_slab_pool<sizeof(Node), alignof(Node)>::block_size();
+		}
+		/**
+		* whether this map shares its node pool with another map or a node
+		*   handle (see split()), so that allocating and freeing nodes takes
+		*   the pool's lock.
+		*/
+		bool shares_pool() const
+		{
+			return t->poolShared();
+		}
+		/**
 		* clears the contents
 		*/
 		void clear()
 		{
-			if(t)
-				t->clear();
-			delete t;
-			t = NULL;
-			t = new RBTree();
+			t->clear();
 		}
 		/**
 		* insert an element.
@@ -1223,46 +2659,191 @@ namespace sjtu {
 		*   the second one is true if insert successfully, or false.
 		*/
 		pair<iterator, bool> insert(const value_type &value) {
-			Node *n = t->find(value.first);
-			if(n == NULL)
-			{
-				n = t->insert(value);
-				if (n != NULL)
-				{
-					iterator iter(n);
-					return pair<iterator, bool>(iter, true);
-				}
-				else
-				{
-					iterator iter = this->end();
-					return pair<iterator, bool>(iter, false);
-				}
-			}
-			else
+			pair<Node*, bool> res = t->insert(value);
+			return pair<iterator, bool>(iterator(res.first), res.second);
+		}
+		pair<iterator, bool> insert(value_type &&value) {
+			pair<Node*, bool> res = t->insert(std::move(value));
+			return pair<iterator, bool>(iterator(res.first), res.second);
+		}
+		/**
+		* insert value as close as possible to the position just before hint.
+		* costs amortized O(1) when the value belongs right before or right after
+		*   hint, e.g. when sorted input is fed with the previous result as hint.
+		* return an iterator to the new element or to the one that prevented the insertion.
+		*/
+		iterator insert(const_iterator hint, const value_type &value)
+		{
+			Node *pNode;
+			bool toLeft;
+			Node *p = t->locateHint(const_cast<Node*>(hint.nd), value.first, pNode, toLeft);
+			if (p == NULL)
+				p = t->insertAt(pNode, toLeft, value);
+			return iterator(p);
+		}
+		iterator insert(const_iterator hint, value_type &&value)
+		{
+			Node *pNode;
+			bool toLeft;
+			Node *p = t->locateHint(const_cast<Node*>(hint.nd), value.first, pNode, toLeft);
+			if (p == NULL)
+				p = t->insertAt(pNode, toLeft, std::move(value));
+			return iterator(p);
+		}
+		template<class... Args>
+		iterator emplace_hint(const_iterator hint, Args&&... args)
+		{
+			return iterator(t->emplaceHint(const_cast<Node*>(hint.nd), std::forward<Args>(args)...).first);
+		}
+		/**
+		* insert a value built in place from args.
+		* the value is constructed before its key is known, so it is destroyed
+		*   again if the key already exists. return value is the same as insert().
+		*/
+		template<class... Args>
+		pair<iterator, bool> emplace(Args&&... args)
+		{
+			pair<Node*, bool> res = t->emplace(std::forward<Args>(args)...);
+			return pair<iterator, bool>(iterator(res.first), res.second);
+		}
+		/**
+		* insert key with a value built from args, if key is not present yet.
+		* nothing is constructed when key already exists.
+		* return value is the same as insert().
+		*/
+		template<class... Args>
+		pair<iterator, bool> try_emplace(const Key &key, Args&&... args)
+		{
+			Node *pNode;
+			bool toLeft;
+			Node *p = t->locate(key, pNode, toLeft);
+			if (p != NULL)
+				return pair<iterator, bool>(iterator(p), false);
+			p = t->insertAt(pNode, toLeft, std::piecewise_construct,
+				std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+			return pair<iterator, bool>(iterator(p), true);
+		}
+		/**
+		* insert (key, obj), or assign obj to the element that already has key.
+		* the second of the returned pair is true if a new element was inserted.
+		*/
+		template<class M>
+		pair<iterator, bool> insert_or_assign(const Key &key, M &&obj)
+		{
+			Node *pNode;
+			bool toLeft;
+			Node *p = t->locate(key, pNode, toLeft);
+			if (p != NULL)
 			{
-				iterator iter(n);
-				return pair<iterator, bool>(iter, false);
+				p->value().second = std::forward<M>(obj);
+				t->refresh(p);
+				return pair<iterator, bool>(iterator(p), false);
 			}
-
+			p = t->insertAt(pNode, toLeft, key, std::forward<M>(obj));
+			return pair<iterator, bool>(iterator(p), true);
 		}
 		/**
-		* erase the element at pos.
+		* erase the element at pos and return the iterator following it.
+		* the node is unlinked where it is, without looking its key up;
+		*   whether pos belongs to this map is checked by climbing to the
+		*   header, O(log n) without comparisons.
 		*
 		* throw if pos pointed to a bad element (pos == this->end() || pos points an element out of this)
 		*/
-		void erase(iterator pos)
+		iterator erase(iterator pos)
 		{
 			if (!pos.nd || pos.nd == t->end())
 				throw index_out_of_bound();
-			Node *p = t->find(pos->first);
-			iterator iter(p); // check if iterator point to this map
-			if (p == NULL || iter != pos)
+			if (!t->owns(pos.nd))
 				throw invalid_iterator();
-			else
+			Node *next = RBTree::nextNode(pos.nd);
+			t->remove(pos.nd);
+			return iterator(next);
+		}
+		/**
+		* unlink the element at pos and hand it over in a node handle; its
+		*   node is neither freed nor copied. iterators to it are invalidated.
+		*
+		* throw as erase(pos) does.
+		*/
+		node_type extract(iterator pos)
+		{
+			if (!pos.nd || pos.nd == t->end())
+				throw index_out_of_bound();
+			if (!t->owns(pos.nd))
+				throw invalid_iterator();
+			node_type nh;
+			t->extract(pos.nd, nh.pool);
+			nh.nd = pos.nd;
+			return nh;
+		}
+		// the element with key in a node handle, or an empty handle
+		node_type extract(const Key &key)
+		{
+			node_type nh;
+			Node *p = t->find(key);
+			if (p != NULL)
 			{
-				value_type vt(pos->first, pos->second);
-				t->remove(vt);
+				t->extract(p, nh.pool);
+				nh.nd = p;
 			}
+			return nh;
+		}
+		/**
+		* link the node of nh into this map, which then shares a pool with
+		*   the map it came from, as after merge(), so nodes of both are
+		*   allocated and freed under the pool's lock.
+		* returns the iterator to the element with its key and whether the
+		*   node was inserted; if the key is already here, or nh is empty,
+		*   nh keeps what it holds.
+		*/
+		pair<iterator, bool> insert(node_type &&nh)
+		{
+			if (nh.nd == NULL)
+				return pair<iterator, bool>(end(), false);
+			pair<Node*, bool> res = t->insertNode(nh.nd, nh.pool);
+			if (res.second)
+				nh.nd = NULL;
+			return pair<iterator, bool>(iterator(res.first), res.second);
+		}
+		/**
+		* erase the elements in [first, last) and return last.
+		* O(k + log n) for k elements: a short range is erased node by node
+		*   and a longer one cut out with split and join.
+		* throw invalid_iterator, erasing nothing, if first or last is not of
+		*   this map or last comes before first.
+		*/
+		iterator erase(iterator first, iterator last)
+		{
+			if (!first.nd || !last.nd || !t->owns(first.nd) || !t->owns(last.nd))
+				throw invalid_iterator();
+			if (first == last)
+				return last;
+			if (first.nd == t->end() || (last.nd != t->end() && !t->compare(first->first, last->first)))
+				throw invalid_iterator();
+			t->eraseRange(first.nd, last.nd);
+			return last;
+		}
+		/**
+		* erase the element with key, if any.
+		* returns the number of elements removed (0 or 1).
+		*/
+		size_t erase(const Key &key)
+		{
+			Node *p = t->find(key);
+			if (p == NULL)
+				return 0;
+			t->remove(p);
+			return 1;
+		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		size_t erase(const K &key)
+		{
+			Node *p = t->find(key);
+			if (p == NULL)
+				return 0;
+			t->remove(p);
+			return 1;
 		}
 		/**
 		* Returns the number of elements with key
@@ -1277,6 +2858,10 @@ namespace sjtu {
 			else
 				return 0;
 		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		size_t count(const K &key) const {
+			return t->find(key) ? 1 : 0;
+		}
 		/**
 		* Finds an element with key equivalent to key.
 		* key value of the element to search for.
@@ -1307,12 +2892,316 @@ namespace sjtu {
 				return const_iterator(cend());
 			}
 		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		iterator find(const K &key)
+		{
+			Node *p = t->find(key);
+			return p ? iterator(p) : end();
+		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		const_iterator find(const K &key) const
+		{
+			Node *p = t->find(key);
+			return p ? const_iterator(p) : cend();
+		}
+		/**
+		* the first element whose key is not less than key, or end().
+		*/
+		iterator lower_bound(const Key &key)
+		{
+			return iterator(t->lowerBound(key));
+		}
+		const_iterator lower_bound(const Key &key) const
+		{
+			return const_iterator(t->lowerBound(key));
+		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		iterator lower_bound(const K &key)
+		{
+			return iterator(t->lowerBound(key));
+		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		const_iterator lower_bound(const K &key) const
+		{
+			return const_iterator(t->lowerBound(key));
+		}
+		/**
+		* the first element whose key is greater than key, or end().
+		*/
+		iterator upper_bound(const Key &key)
+		{
+			return iterator(t->upperBound(key));
+		}
+		const_iterator upper_bound(const Key &key) const
+		{
+			return const_iterator(t->upperBound(key));
+		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		iterator upper_bound(const K &key)
+		{
+			return iterator(t->upperBound(key));
+		}
+		template<class K, class C = Compare, class = typename C::is_transparent>
+		const_iterator upper_bound(const K &key) const
+		{
+			return const_iterator(t->upperBound(key));
+		}
+		/**
+		* the number of elements whose key is less than key, in O(log n).
+		* only with the order_statistic augmentation.
+		*/
+		size_t rank(const Key &key) const
+		{
+			static_assert(Augment::counts, "rank() needs the order_statistic augmentation");
+			return t->rank(key);
+		}
+		/**
+		* the element with rank k, i.e. the (k + 1)-th smallest, in O(log n).
+		* end() if k >= size(). only with the order_statistic augmentation.
+		*/
+		iterator select(size_t k)
+		{
+			static_assert(Augment::counts, "select() needs the order_statistic augmentation");
+			return iterator(RBTree::select(t->end(), k));
+		}
+		const_iterator select(size_t k) const
+		{
+			static_assert(Augment::counts, "select() needs the order_statistic augmentation");
+			return const_iterator(RBTree::select(t->end(), k));
+		}
+		/**
+		* the aggregate of the elements with key in [lo, hi), combined in key order,
+		*   in O(log n). identity if the range is empty.
+		* only with the aggregate augmentation.
+		*/
+		template<class A = Augment>
+		typename A::value_type range_reduce(const Key &lo, const Key &hi) const
+		{
+			static_assert(Augment::reduces, "range_reduce() needs the aggregate augmentation");
+			return t->rangeReduce(lo, hi);
+		}
+		/**
+		* recompute the augmented data after the value at pos was changed in
+		*   place, through operator[] or the iterator itself.
+		* throw invalid_iterator if pos is end() or points to nothing.
+		*/
+		void refresh(iterator pos)
+		{
+			if (pos.nd == NULL || pos.nd == t->end())
+				throw invalid_iterator();
+			t->refresh(pos.nd);
+		}
+		/**
+		* an immutable copy laid out for fast lookups, see frozen_map.
+		* costs O(n); later changes to this map do not reach it.
+		*/
+		frozen_map<Key, T, Compare> freeze() const
+		{
+			return frozen_map<Key, T, Compare>(cbegin(), cend(), t->keyComp());
+		}
+		/**
+		* move the elements whose key is not less than key into a new map, in
+		*   O(log n).
+		* this and the following operations relink nodes between maps, so
+		*   nothing is allocated or copied and iterators stay valid, following
+		*   their element into the other map. maps that have exchanged nodes
+		*   share a node pool from then on (see shared_slab_pool): they may
+		*   still be used on different threads, but allocating and freeing
+		*   nodes in them takes the pool's lock. a map that is emptied (by
+		*   clear(), erasing or giving away its last element) stops sharing.
+		* after a split, size() of either map counts its elements once, in
+		*   O(n) unless Augment counts.
+		*/
+		map split(const Key &key)
+		{
+			map res;
+			t->splitOff(key, *res.t);
+			return res;
+		}
+		/**
+		* append the elements of other, whose keys must all be greater than
+		*   the keys here, in O(log n); other is left empty.
+		* throw runtime_error and change nothing if they are not.
+		* both maps share a node pool from then on, see split().
+		*/
+		void join(map &other)
+		{
+			if (!t->precedes(*other.t))
+				throw runtime_error();
+			t->append(*other.t);
+		}
+		/**
+		* move the elements of other whose key is not here into this map; the
+		*   others stay in other, as with std::map::merge.
+		* O(m log(n / m + 1)) for sizes m <= n, against O(m log n) for
+		*   inserting one by one, plus O(k log k) for the k keys left behind.
+		* both maps share a node pool from then on, see split().
+		*/
+		void merge(map &other)
+		{
+			t->unite(*other.t, true);
+		}
+		/**
+		* the union with other: its elements whose key is not here move into
+		*   this map and the rest are destroyed; other is left empty.
+		*   O(m log(n / m + 1)) for sizes m <= n.
+		* both maps share a node pool from then on, see split().
+		*/
+		void set_union(map &other)
+		{
+			t->unite(*other.t, false);
+		}
+		/**
+		* set_union() on up to threads threads, one per hardware thread if 0:
+		*   where both sides are large the halves of a split are united on
+		*   different threads. the result is the same as set_union()'s.
+		*/
+		void parallel_union(map &other, unsigned threads = 0)
+		{
+			t->unite(*other.t, false, threadCount(threads));
+		}
+		/**
+		* insert the pairs in [first, last) on up to threads threads, one per
+		*   hardware thread if 0; the first of equal keys wins and keys
+		*   already here stay, as with insert() one by one.
+		* every thread sorts its share of the input and builds a map from it
+		*   in O(k), and these are united into this map with parallel_union().
+		*/
+		template<class ForwardIt>
+		void parallel_insert(ForwardIt first, ForwardIt last, unsigned threads = 0)
+		{
+			size_t n = 0;
+			for (ForwardIt it = first; it != last; ++it)
+				n++;
+			t->insertParallel(first, n, threadCount(threads));
+		}
+		/**
+		* apply a batch of upserts and erases (see batch_op), with the same
+		*   outcome as applying them one by one in order, and fill in the
+		*   result of each.
+		* the batch is sorted by key and the tree walked once: it is split at
+		*   the keys of the batch and joined back around the nodes made or
+		*   found there, so descents and rebalancing are shared between
+		*   neighbouring keys. O(m log m + m log(n / m + 1)) for m operations.
+		* if an operation throws, the ones sorted before it are applied and the
+		*   rest are not.
+		*/
+		void apply_batch(vector<batch_op> &ops)
+		{
+			size_t n = ops.size();
+			if (n == 0)
+				return;
+			batch_op **order = new batch_op*[n];
+			try {
+				for (size_t i = 0; i < n; i++)
+					order[i] = &ops[i];
+				std::stable_sort(order, order + n, [this](const batch_op *a, const batch_op *b) {
+					return t->compare(a->key, b->key);
+				});
+				t->applyBatch(order, n);
+			}
+			catch (...) {
+				delete[] order;
+				throw;
+			}
+			delete[] order;
+		}
+		/**
+		* keep only the elements whose key other has too.
+		*   O(m log(n / m + 1)) for sizes m <= n.
+		*/
+		void set_intersection(const map &other)
+		{
+			t->intersect(*other.t);
+		}
+		/**
+		* erase the elements whose key other has.
+		*   O(m log(n / m + 1)) for sizes m <= n.
+		*/
+		void set_difference(const map &other)
+		{
+			t->subtract(*other.t);
+		}
+		/**
+		* the elements with key equivalent to key: [lower_bound, upper_bound).
+		*/
+		pair<iterator, iterator> equal_range(const Key &key)
+		{
+			Node *p = t->find(key);
+			if (p == NULL)
+			{
+				iterator it = lower_bound(key);
+				return pair<iterator, iterator>(it, it);
+			}
+			return pair<iterator, iterator>(iterator(p), iterator(RBTree::nextNode(p)));
+		}
+		pair<const_iterator, const_iterator> equal_range(const Key &key) const
+		{
+			Node *p = t->find(key);
+			if (p == NULL)
+			{
+				const_iterator it = lower_bound(key);
+				return pair<const_iterator, const_iterator>(it, it);
+			}
+			return pair<const_iterator, const_iterator>(const_iterator(p), const_iterator(RBTree::nextNode(p)));
+		}
+		/**
+		* the elements with lo <= key < hi, to be walked with begin()/end() or
+		*   a range-for. finding the bounds costs O(log n), walking k elements O(k).
+		* the view is empty when hi is not greater than lo.
+		*/
+		template<class It>
+		class range_view {
+		public:
+			range_view(const It &first, const It &last) : first(first), last(last) {}
+			It begin() const {
+				return first;
+			}
+			It end() const {
+				return last;
+			}
+			bool empty() const {
+				return first == last;
+			}
+		private:
+			It first;
+			It last;
+		};
+		range_view<iterator> range(const Key &lo, const Key &hi)
+		{
+			iterator first = lower_bound(lo);
+			if (!t->compare(lo, hi))
+				return range_view<iterator>(first, first);
+			return range_view<iterator>(first, lower_bound(hi));
+		}
+		range_view<const_iterator> range(const Key &lo, const Key &hi) const
+		{
+			const_iterator first = lower_bound(lo);
+			if (!t->compare(lo, hi))
+				return range_view<const_iterator>(first, first);
+			return range_view<const_iterator>(first, lower_bound(hi));
+		}
 		void print() { t->print(); }
 	private:
 		void copyMap(const RBTree &other)
 		{
 			t = new RBTree(other);
 		}
+		// the mapped value of p as operator[] hands it out
+		T & mapped(Node *p, std::false_type)
+		{
+			return p->value().second;
+		}
+		mapped_ref mapped(Node *p, std::true_type)
+		{
+			return mapped_ref(t, p);
+		}
+		static unsigned threadCount(unsigned threads)
+		{
+			if (threads == 0)
+				threads = std::thread::hardware_concurrency();
+			return threads == 0 ? 1 : threads;
+		}
 	private:
 		RBTree* t;
 	};
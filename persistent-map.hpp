@@ -0,0 +1,550 @@
+/**
+* a map whose versions share their nodes
+*/
+#ifndef SJTU_PERSISTENT_MAP_HPP
+#define SJTU_PERSISTENT_MAP_HPP
+
+#include <functional>
+#include <cstddef>
+#include <atomic>
+#include <utility>
+#include "utility.hpp"
+#include "exceptions.hpp"
+
+namespace sjtu {
+
+	/**
+	* an ordered map with O(1) copies: a copy, or snapshot(), shares every
+	*   node with the map it came from.
+	* the tree is an AVL tree without parent links, and nodes are reference
+	*   counted by the links and versions pointing at them. an update walks
+	*   down from the root and copies each node on its path that some other
+	*   version can still reach, O(log n) nodes at most; a node only this
+	*   version reaches is changed in place, so a map nobody has copied
+	*   updates without allocating more than sjtu::map does. a node is freed
+	*   with the last link to it.
+	* nodes reachable from two versions are never written, so versions can be
+	*   read and changed on different threads without locks; a single version
+	*   is no more thread-safe than sjtu::map.
+	* elements are read through const iterators only, and a change to a
+	*   version invalidates the iterators into it. iterators into other
+	*   versions stay valid while those versions live.
+	*/
+	template<
+		class Key,
+		class T,
+		class Compare = std::less<Key>
+	> class persistent_map {
+	public:
+		typedef pair<const Key, T> value_type;
+	private:
+		class Node {
+		public:
+			template<class... Args>
+			Node(Node *left, Node *right, int height, Args&&... args)
+				: value(std::forward<Args>(args)...), left(left), right(right), height(height), refs(1) {}
+			value_type value;
+			Node *left;
+			Node *right;
+			int height;
+			std::atomic<long> refs;
+		};
+		// the height of an AVL tree of 2^48 nodes stays below this
+		static const int MAX_HEIGHT = 72;
+	public:
+		/**
+		* a walk in key order. it keeps the path from the root, so moving on
+		*   costs amortized O(1) without parent links.
+		*/
+		class const_iterator {
+		public:
+			const_iterator() : root(NULL), depth(0) {}
+			const value_type & operator*() const
+			{
+				return path[depth - 1]->value;
+			}
+			const value_type* operator->() const
+			{
+				return &path[depth - 1]->value;
+			}
+			const_iterator operator++(int)
+			{
+				const_iterator tmp(*this);
+				++*this;
+				return tmp;
+			}
+			const_iterator & operator++()
+			{
+				if (depth == 0)
+					throw index_out_of_bound();
+				const Node *p = path[depth - 1];
+				if (p->right != NULL)
+					pushLeft(p->right);
+				else
+				{
+					// climb until we come up from a left child
+					depth--;
+					while (depth > 0 && path[depth - 1]->right == p)
+						p = path[--depth];
+				}
+				return *this;
+			}
+			const_iterator operator--(int)
+			{
+				const_iterator tmp(*this);
+				--*this;
+				return tmp;
+			}
+			const_iterator & operator--()
+			{
+				if (depth == 0)
+				{
+					if (root == NULL)
+						throw index_out_of_bound();
+					pushRight(root);
+					return *this;
+				}
+				const Node *p = path[depth - 1];
+				if (p->left != NULL)
+				{
+					pushRight(p->left);
+					return *this;
+				}
+				int d = depth - 1;
+				while (d > 0 && path[d - 1]->left == p)
+					p = path[--d];
+				// nothing before the first element
+				if (d == 0)
+					throw index_out_of_bound();
+				depth = d;
+				return *this;
+			}
+			bool operator==(const const_iterator &rhs) const
+			{
+				if (depth == 0 || rhs.depth == 0)
+					return depth == rhs.depth && root == rhs.root;
+				return path[depth - 1] == rhs.path[rhs.depth - 1];
+			}
+			bool operator!=(const const_iterator &rhs) const
+			{
+				return !(*this == rhs);
+			}
+		private:
+			friend class persistent_map;
+			void pushLeft(const Node *p)
+			{
+				for (; p != NULL; p = p->left)
+					path[depth++] = p;
+			}
+			void pushRight(const Node *p)
+			{
+				for (; p != NULL; p = p->right)
+					path[depth++] = p;
+			}
+			const Node *root;
+			// path[depth - 1] is the element, depth 0 is end()
+			int depth;
+			const Node *path[MAX_HEIGHT];
+		};
+		typedef const_iterator iterator;
+
+		persistent_map() : root(NULL), _size(0) {}
+		/**
+		* O(1): the copy shares all nodes with other.
+		*/
+		persistent_map(const persistent_map &other) : root(retain(other.root)), _size(other._size), comp(other.comp) {}
+		persistent_map(persistent_map &&other) : root(other.root), _size(other._size), comp(other.comp) {
+			other.root = NULL;
+			other._size = 0;
+		}
+		/**
+		* construct from the pairs in [first, last); the first of equal keys wins.
+		*/
+		template<class InputIt>
+		persistent_map(InputIt first, InputIt last) : root(NULL), _size(0) {
+			for (; first != last; ++first)
+				insert(value_type((*first).first, (*first).second));
+		}
+		persistent_map & operator=(const persistent_map &other) {
+			if (this != &other)
+			{
+				Node *old = root;
+				root = retain(other.root);
+				_size = other._size;
+				comp = other.comp;
+				release(old);
+			}
+			return *this;
+		}
+		persistent_map & operator=(persistent_map &&other) {
+			if (this != &other)
+			{
+				release(root);
+				root = other.root;
+				_size = other._size;
+				comp = other.comp;
+				other.root = NULL;
+				other._size = 0;
+			}
+			return *this;
+		}
+		~persistent_map() {
+			release(root);
+		}
+		/**
+		* this version as it is now, in O(1). it can be read, copied, changed
+		*   or handed to another thread independently of this map.
+		*/
+		persistent_map snapshot() const
+		{
+			return persistent_map(*this);
+		}
+		/**
+		* the mapped value of key, throw index_out_of_bound if there is none.
+		*/
+		const T & at(const Key &key) const
+		{
+			const Node *p = findNode(key);
+			if (p == NULL)
+				throw index_out_of_bound();
+			return p->value.second;
+		}
+		const T & operator[](const Key &key) const
+		{
+			return at(key);
+		}
+		const_iterator begin() const
+		{
+			const_iterator it;
+			it.root = root;
+			it.pushLeft(root);
+			return it;
+		}
+		const_iterator cbegin() const
+		{
+			return begin();
+		}
+		const_iterator end() const
+		{
+			const_iterator it;
+			it.root = root;
+			return it;
+		}
+		const_iterator cend() const
+		{
+			return end();
+		}
+		bool empty() const
+		{
+			return _size == 0;
+		}
+		size_t size() const
+		{
+			return _size;
+		}
+		/**
+		* drop this version's nodes; other versions keep theirs.
+		*/
+		void clear()
+		{
+			release(root);
+			root = NULL;
+			_size = 0;
+		}
+		/**
+		* insert value unless its key is there; true if it was inserted.
+		* nothing is copied when the key is already there.
+		*/
+		bool insert(const value_type &value)
+		{
+			if (findNode(value.first) != NULL)
+				return false;
+			insertNode(root, value.first, value);
+			_size++;
+			return true;
+		}
+		bool insert(value_type &&value)
+		{
+			if (findNode(value.first) != NULL)
+				return false;
+			insertNode(root, value.first, std::move(value));
+			_size++;
+			return true;
+		}
+		/**
+		* map key to obj whether or not it was there; true if it was not.
+		*/
+		template<class M>
+		bool insert_or_assign(const Key &key, M &&obj)
+		{
+			bool inserted = assignNode(root, key, std::forward<M>(obj));
+			if (inserted)
+				_size++;
+			return inserted;
+		}
+		/**
+		* erase the element with key, if any.
+		* returns the number of elements removed (0 or 1).
+		*/
+		size_t erase(const Key &key)
+		{
+			if (findNode(key) == NULL)
+				return 0;
+			eraseNode(root, key);
+			_size--;
+			return 1;
+		}
+		size_t count(const Key &key) const
+		{
+			return findNode(key) == NULL ? 0 : 1;
+		}
+		const_iterator find(const Key &key) const
+		{
+			const_iterator it = lower_bound(key);
+			if (it.depth > 0 && comp(key, it->first))
+				return end();
+			return it;
+		}
+		/**
+		* the first element whose key is not less than key, end() if none.
+		*/
+		const_iterator lower_bound(const Key &key) const
+		{
+			const_iterator it;
+			it.root = root;
+			int keep = 0;
+			for (const Node *p = root; p != NULL; )
+			{
+				it.path[it.depth++] = p;
+				if (comp(p->value.first, key))
+					p = p->right;
+				else
+				{
+					keep = it.depth;
+					p = p->left;
+				}
+			}
+			it.depth = keep;
+			return it;
+		}
+		/**
+		* the first element whose key is greater than key, end() if none.
+		*/
+		const_iterator upper_bound(const Key &key) const
+		{
+			const_iterator it;
+			it.root = root;
+			int keep = 0;
+			for (const Node *p = root; p != NULL; )
+			{
+				it.path[it.depth++] = p;
+				if (!comp(key, p->value.first))
+					p = p->right;
+				else
+				{
+					keep = it.depth;
+					p = p->left;
+				}
+			}
+			it.depth = keep;
+			return it;
+		}
+	private:
+		static Node * retain(Node *p)
+		{
+			if (p != NULL)
+				p->refs.fetch_add(1, std::memory_order_relaxed);
+			return p;
+		}
+		// drop one link to p, freeing whatever no longer has any
+		static void release(Node *p)
+		{
+			while (p != NULL && p->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				Node *right = p->right;
+				release(p->left);
+				delete p;
+				p = right;
+			}
+		}
+		/**
+		* make p a node with the same content that only this link points to:
+		*   p itself when nothing else does, else a copy sharing its children.
+		* if the copy throws, p is left as it was.
+		*/
+		static void own(Node *&p)
+		{
+			if (p->refs.load(std::memory_order_acquire) == 1)
+				return;
+			Node *q = new Node(p->left, p->right, p->height, p->value);
+			retain(q->left);
+			retain(q->right);
+			release(p);
+			p = q;
+		}
+		static int height(const Node *p)
+		{
+			return p == NULL ? 0 : p->height;
+		}
+		static void fix(Node *p)
+		{
+			int l = height(p->left), r = height(p->right);
+			p->height = (l > r ? l : r) + 1;
+		}
+		// p is owned
+		static void rotateRight(Node *&p)
+		{
+			own(p->left);
+			Node *l = p->left;
+			p->left = l->right;
+			l->right = p;
+			fix(p);
+			fix(l);
+			p = l;
+		}
+		static void rotateLeft(Node *&p)
+		{
+			own(p->right);
+			Node *r = p->right;
+			p->right = r->left;
+			r->left = p;
+			fix(p);
+			fix(r);
+			p = r;
+		}
+		// p is owned and its subtrees differ in height by 2 at most
+		static void balance(Node *&p)
+		{
+			int l = height(p->left), r = height(p->right);
+			if (l > r + 1)
+			{
+				if (height(p->left->left) < height(p->left->right))
+				{
+					own(p->left);
+					rotateLeft(p->left);
+				}
+				rotateRight(p);
+			}
+			else if (r > l + 1)
+			{
+				if (height(p->right->right) < height(p->right->left))
+				{
+					own(p->right);
+					rotateRight(p->right);
+				}
+				rotateLeft(p);
+			}
+			else
+				fix(p);
+		}
+		const Node * findNode(const Key &key) const
+		{
+			const Node *p = root;
+			while (p != NULL)
+			{
+				if (comp(key, p->value.first))
+					p = p->left;
+				else if (comp(p->value.first, key))
+					p = p->right;
+				else
+					return p;
+			}
+			return NULL;
+		}
+		/**
+		* the update walks below change the subtree behind the link p. every
+		*   link they write points at a complete subtree, so if a copy throws
+		*   half way the version is still whole, with some nodes copied early.
+		*/
+		// key is not in the subtree of p
+		template<class V>
+		void insertNode(Node *&p, const Key &key, V &&value)
+		{
+			if (p == NULL)
+			{
+				p = new Node(NULL, NULL, 1, std::forward<V>(value));
+				return;
+			}
+			own(p);
+			if (comp(key, p->value.first))
+				insertNode(p->left, key, std::forward<V>(value));
+			else
+				insertNode(p->right, key, std::forward<V>(value));
+			balance(p);
+		}
+		template<class M>
+		bool assignNode(Node *&p, const Key &key, M &&obj)
+		{
+			if (p == NULL)
+			{
+				p = new Node(NULL, NULL, 1, key, std::forward<M>(obj));
+				return true;
+			}
+			own(p);
+			bool inserted;
+			if (comp(key, p->value.first))
+				inserted = assignNode(p->left, key, std::forward<M>(obj));
+			else if (comp(p->value.first, key))
+				inserted = assignNode(p->right, key, std::forward<M>(obj));
+			else
+			{
+				p->value.second = std::forward<M>(obj);
+				return false;
+			}
+			if (inserted)
+				balance(p);
+			return inserted;
+		}
+		// key is in the subtree of p
+		void eraseNode(Node *&p, const Key &key)
+		{
+			own(p);
+			if (comp(key, p->value.first))
+				eraseNode(p->left, key);
+			else if (comp(p->value.first, key))
+				eraseNode(p->right, key);
+			else
+			{
+				Node *q = p;
+				if (q->left == NULL || q->right == NULL)
+				{
+					// the child may be shared and needs no balancing
+					p = q->left == NULL ? q->right : q->left;
+					q->left = q->right = NULL;
+					release(q);
+					return;
+				}
+				// the successor takes q's place, its value is not copied
+				Node *next;
+				detachMin(q->right, next);
+				next->left = q->left;
+				next->right = q->right;
+				p = next;
+				q->left = q->right = NULL;
+				release(q);
+			}
+			balance(p);
+		}
+		// unlink the smallest node of the subtree into min, owned
+		static void detachMin(Node *&p, Node *&min)
+		{
+			own(p);
+			if (p->left == NULL)
+			{
+				min = p;
+				p = p->right;
+				min->right = NULL;
+				return;
+			}
+			detachMin(p->left, min);
+			balance(p);
+		}
+	private:
+		Node *root;
+		size_t _size;
+		Compare comp;
+	};
+
+}
+
+#endif
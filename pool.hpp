@@ -0,0 +1,326 @@
+#ifndef SJTU_POOL_HPP
+#define SJTU_POOL_HPP
+
+#include <cstddef>
+#include <new>
+#include <atomic>
+#include <mutex>
+
+namespace sjtu {
+
+/**
+* a fixed-size block allocator.
+* blocks of one size class are carved out of slabs taken from operator new.
+* a freed block goes on a free list and is handed out again before a slab
+*   is touched, so blocks allocated one after another sit next to each other.
+* release() drops every slab at once: a container owning the pool does not
+*   have to give its blocks back one by one.
+*/
+template<size_t Size, size_t Align = alignof(void*)>
+class slab_pool {
+private:
+	struct block { block *next; };
+	struct slab { slab *next; };
+	static const size_t BLOCK_ALIGN = Align < alignof(block) ? alignof(block) : Align;
+	static const size_t BLOCK_SIZE = ((Size < sizeof(block) ? sizeof(block) : Size) + BLOCK_ALIGN - 1) / BLOCK_ALIGN * BLOCK_ALIGN;
+	static const size_t HEADER_SIZE = (sizeof(slab) + BLOCK_ALIGN - 1) / BLOCK_ALIGN * BLOCK_ALIGN;
+	static const size_t FIRST_SLAB = 16;
+	static const size_t MAX_SLAB = 1024;
+	static_assert(Align <= alignof(std::max_align_t), "slab_pool does not support over-aligned blocks");
+public:
+	slab_pool() : slabs(NULL), lastSlab(NULL), freeList(NULL), cursor(NULL), limit(NULL), slabBlocks(FIRST_SLAB) {}
+	slab_pool(const slab_pool &other) = delete;
+	slab_pool & operator=(const slab_pool &other) = delete;
+	~slab_pool()
+	{
+		release();
+	}
+	void *allocate()
+	{
+		if (freeList)
+		{
+			block *b = freeList;
+			freeList = b->next;
+			return b;
+		}
+		if (cursor == limit)
+			grow();
+		void *p = cursor;
+		cursor += BLOCK_SIZE;
+		return p;
+	}
+	/**
+	* n blocks next to each other, e.g. for building a whole container at once.
+	* they are given back one by one with deallocate() or all together by release().
+	*/
+	void *allocate_run(size_t n)
+	{
+		if (static_cast<size_t>(limit - cursor) >= n * BLOCK_SIZE)
+		{
+			void *p = cursor;
+			cursor += n * BLOCK_SIZE;
+			return p;
+		}
+		// a slab of its own, the current one keeps serving allocate()
+		slab *s = static_cast<slab*>(::operator new(HEADER_SIZE + n * BLOCK_SIZE));
+		push(s);
+		return reinterpret_cast<char*>(s) + HEADER_SIZE;
+	}
+	void deallocate(void *p)
+	{
+		block *b = static_cast<block*>(p);
+		b->next = freeList;
+		freeList = b;
+	}
+	/**
+	* give every slab back to the system.
+	* any block still handed out becomes invalid.
+	*/
+	void release()
+	{
+		while (slabs)
+		{
+			slab *s = slabs;
+			slabs = s->next;
+			::operator delete(s);
+		}
+		lastSlab = NULL;
+		freeList = NULL;
+		cursor = limit = NULL;
+		slabBlocks = FIRST_SLAB;
+	}
+	/**
+	* take over every slab of other, which is left empty; the blocks other
+	*   handed out now belong to this pool. O(1): the free list of other is
+	*   only kept when this one has none, otherwise its blocks stay unused
+	*   until release().
+	*/
+	void absorb(slab_pool &other)
+	{
+		if (other.slabs == NULL)
+			return;
+		other.lastSlab->next = slabs;
+		if (slabs == NULL)
+			lastSlab = other.lastSlab;
+		slabs = other.slabs;
+		if (freeList == NULL)
+			freeList = other.freeList;
+		if (other.limit - other.cursor > limit - cursor)
+		{
+			cursor = other.cursor;
+			limit = other.limit;
+		}
+		if (other.slabBlocks > slabBlocks)
+			slabBlocks = other.slabBlocks;
+		other.slabs = other.lastSlab = NULL;
+		other.release();
+	}
+	static size_t block_size()
+	{
+		return BLOCK_SIZE;
+	}
+private:
+	void grow()
+	{
+		slab *s = static_cast<slab*>(::operator new(HEADER_SIZE + slabBlocks * BLOCK_SIZE));
+		push(s);
+		cursor = reinterpret_cast<char*>(s) + HEADER_SIZE;
+		limit = cursor + slabBlocks * BLOCK_SIZE;
+		if (slabBlocks < MAX_SLAB)
+			slabBlocks *= 2;
+	}
+	void push(slab *s)
+	{
+		if (slabs == NULL)
+			lastSlab = s;
+		s->next = slabs;
+		slabs = s;
+	}
+private:
+	slab *slabs;
+	// the oldest slab, where absorb() splices
+	slab *lastSlab;
+	block *freeList;
+	char *cursor;
+	char *limit;
+	size_t slabBlocks;
+};
+
+/**
+* a slab_pool that containers can come to share: a handle to a group of
+*   pools joined by share().
+* containers that move nodes to each other share their pool, so a node
+*   can outlive the container that allocated it. sharing merges the
+*   slabs of both groups into one; a handle to a merged group forwards to
+*   the group it went into. the slabs go back to the system with the last
+*   handle.
+* handles of one group may be used on different threads: a group with
+*   more than one user is locked around every allocation and free, while
+*   the only handle of a group goes without. a single handle is not
+*   synchronized, and share() and enter() need both handles on one thread.
+*/
+template<size_t Size, size_t Align = alignof(void*)>
+class shared_slab_pool {
+private:
+	struct group {
+		group() : refs(1), parent(NULL) {}
+		slab_pool<Size, Align> pool;
+		std::mutex lock;
+		// handles, plus groups forwarding here
+		std::atomic<size_t> refs;
+		std::atomic<group*> parent;
+	};
+public:
+	// the group is made on first use
+	shared_slab_pool() : g(NULL) {}
+	shared_slab_pool(const shared_slab_pool &other) = delete;
+	shared_slab_pool & operator=(const shared_slab_pool &other) = delete;
+	~shared_slab_pool()
+	{
+		drop(g);
+	}
+	void *allocate()
+	{
+		std::unique_lock<std::mutex> guard;
+		return use(guard)->pool.allocate();
+	}
+	void *allocate_run(size_t n)
+	{
+		std::unique_lock<std::mutex> guard;
+		return use(guard)->pool.allocate_run(n);
+	}
+	void deallocate(void *p)
+	{
+		std::unique_lock<std::mutex> guard;
+		use(guard)->pool.deallocate(p);
+	}
+	/**
+	* give every slab back, as slab_pool::release(), if no other handle
+	*   shares them; returns false and does nothing otherwise.
+	*/
+	bool release()
+	{
+		if (g == NULL)
+			return true;
+		group *r = top();
+		if (r->refs.load(std::memory_order_acquire) > 1)
+			return false;
+		r->pool.release();
+		return true;
+	}
+	/**
+	* let go of the group; the next allocation starts a new one. blocks
+	*   handed out before stay valid while other handles share them.
+	*/
+	void leave()
+	{
+		drop(g);
+		g = NULL;
+	}
+	/**
+	* after this, both handles allocate from one pool holding the slabs of
+	*   both, and every block either of them handed out lives as long as
+	*   either handle.
+	*/
+	void share(shared_slab_pool &other)
+	{
+		// a handle without a group just enters the other's
+		if (g == NULL)
+		{
+			enter(other);
+			return;
+		}
+		if (other.g == NULL)
+		{
+			other.enter(*this);
+			return;
+		}
+		for (;;)
+		{
+			group *a = top(), *b = other.top();
+			if (a == b)
+				return;
+			// lock in address order; a group merged meanwhile is looked up again
+			std::unique_lock<std::mutex> first(a < b ? a->lock : b->lock), second(a < b ? b->lock : a->lock);
+			if (a->parent.load(std::memory_order_acquire) != NULL || b->parent.load(std::memory_order_acquire) != NULL)
+				continue;
+			a->pool.absorb(b->pool);
+			a->refs.fetch_add(2, std::memory_order_relaxed);
+			b->parent.store(a, std::memory_order_release);
+			first.unlock();
+			second.unlock();
+			other.g = a;
+			drop(b);
+			return;
+		}
+	}
+	/**
+	* leave this handle's group for the one of other, which keeps every
+	*   block other handed out valid for as long as this handle is in it.
+	*   nothing is allocated unless other has no group yet.
+	*/
+	void enter(shared_slab_pool &other)
+	{
+		group *r = other.top();
+		r->refs.fetch_add(1, std::memory_order_relaxed);
+		drop(g);
+		g = r;
+	}
+	bool shared() const
+	{
+		return g != NULL && (g->refs.load(std::memory_order_acquire) > 1 || g->parent.load(std::memory_order_acquire) != NULL);
+	}
+	static size_t block_size()
+	{
+		return slab_pool<Size, Align>::block_size();
+	}
+private:
+	// the group this handle allocates from, pointing the handle at it directly
+	group *top()
+	{
+		if (g == NULL)
+			g = new group();
+		group *r = g->parent.load(std::memory_order_acquire);
+		if (r == NULL)
+			return g;
+		// the groups on the way are kept alive by the ones forwarding to them
+		for (group *up = r->parent.load(std::memory_order_acquire); up != NULL; up = r->parent.load(std::memory_order_acquire))
+			r = up;
+		r->refs.fetch_add(1, std::memory_order_relaxed);
+		drop(g);
+		g = r;
+		return g;
+	}
+	/**
+	* the group to allocate from, locked into guard unless this handle is
+	*   its only user: then nobody else can reach it, or merge it away.
+	*/
+	group *use(std::unique_lock<std::mutex> &guard)
+	{
+		for (;;)
+		{
+			group *r = top();
+			if (r->refs.load(std::memory_order_acquire) == 1 && r->parent.load(std::memory_order_acquire) == NULL)
+				return r;
+			guard = std::unique_lock<std::mutex>(r->lock);
+			if (r->parent.load(std::memory_order_acquire) == NULL)
+				return r;
+			guard.unlock();
+		}
+	}
+	static void drop(group *x)
+	{
+		while (x != NULL && x->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			group *p = x->parent.load(std::memory_order_acquire);
+			delete x;
+			x = p;
+		}
+	}
+private:
+	group *g;
+};
+
+}
+
+#endif
@@ -0,0 +1,440 @@
+/**
+* a lock-free ordered map
+*/
+#ifndef SJTU_SKIPLIST_MAP_HPP
+#define SJTU_SKIPLIST_MAP_HPP
+
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <new>
+#include "utility.hpp"
+#include "exceptions.hpp"
+#include "epoch.hpp"
+
+namespace sjtu {
+
+	/**
+	* an ordered map in a lock-free skiplist: insert, erase and lookups only
+	*   use compare-and-swap, so no thread ever waits for another.
+	* erase first marks the links of a node (the low bit of each next
+	*   pointer), top level down; whoever marks level 0 has erased it. any
+	*   search that walks past a marked node unlinks it. a node is retired to
+	*   the epoch domain (see epoch) once it is erased and both the eraser and
+	*   its inserter, which may still be linking its upper levels, are done
+	*   with it.
+	* an element cannot change once inserted: lookups copy values out and
+	*   iterators give const access.
+	* every operation pins the epoch; an iterator keeps it pinned while it
+	*   lives, so it must stay on its thread and should not be kept long.
+	*/
+	template<
+		class Key,
+		class T,
+		class Compare = std::less<Key>
+	> class concurrent_skiplist_map {
+	public:
+		typedef pair<const Key, T> value_type;
+	private:
+		static const int MAX_LEVEL = 20;
+		class Node {
+		public:
+			template<class... Args>
+			Node(int height, Args&&... args) : value(std::forward<Args>(args)...), height(height), links(2) {}
+			value_type value;
+			int height;
+			// the inserter and the eraser each hold one, the last to let go retires the node
+			std::atomic<int> links;
+			// height links, allocated with the node
+			std::atomic<uintptr_t> next[1];
+		};
+		static Node * ptr(uintptr_t link)
+		{
+			return reinterpret_cast<Node*>(link & ~static_cast<uintptr_t>(1));
+		}
+		static bool marked(uintptr_t link)
+		{
+			return link & 1;
+		}
+		static uintptr_t raw(Node *p)
+		{
+			return reinterpret_cast<uintptr_t>(p);
+		}
+	public:
+		/**
+		* a walk over the elements in key order, skipping erased ones.
+		*/
+		class const_iterator {
+		public:
+			const_iterator() : nd(NULL) {}
+			const value_type & operator*() const
+			{
+				return nd->value;
+			}
+			const value_type* operator->() const
+			{
+				return &nd->value;
+			}
+			const_iterator operator++(int)
+			{
+				const_iterator tmp(*this);
+				++*this;
+				return tmp;
+			}
+			const_iterator & operator++()
+			{
+				if (nd == NULL)
+					throw index_out_of_bound();
+				nd = live(ptr(nd->next[0].load(std::memory_order_acquire)));
+				return *this;
+			}
+			bool operator==(const const_iterator &rhs) const
+			{
+				return nd == rhs.nd;
+			}
+			bool operator!=(const const_iterator &rhs) const
+			{
+				return nd != rhs.nd;
+			}
+		private:
+			friend class concurrent_skiplist_map;
+			// declared first, so the epoch is pinned before nd is looked up
+			epoch::guard pin;
+			Node *nd;
+		};
+		typedef const_iterator iterator;
+
+		concurrent_skiplist_map() : _size(0) {
+			for (int i = 0; i < MAX_LEVEL; i++)
+				head[i].store(0, std::memory_order_relaxed);
+		}
+		concurrent_skiplist_map(const concurrent_skiplist_map &other) = delete;
+		concurrent_skiplist_map & operator=(const concurrent_skiplist_map &other) = delete;
+		/**
+		* no other thread may use the map any more.
+		*/
+		~concurrent_skiplist_map() {
+			Node *p = ptr(head[0].load(std::memory_order_acquire));
+			while (p != NULL)
+			{
+				Node *q = ptr(p->next[0].load(std::memory_order_relaxed));
+				drop(p);
+				p = q;
+			}
+		}
+		/**
+		* a copy of the value mapped to key,
+		*   throw index_out_of_bound if there is none.
+		*/
+		T at(const Key &key) const
+		{
+			epoch::guard g;
+			Node *p = lowerBound(key);
+			if (p == NULL || comp(key, p->value.first))
+				throw index_out_of_bound();
+			return p->value.second;
+		}
+		const T operator[](const Key &key) const
+		{
+			return at(key);
+		}
+		size_t count(const Key &key) const
+		{
+			epoch::guard g;
+			Node *p = lowerBound(key);
+			return p != NULL && !comp(key, p->value.first) ? 1 : 0;
+		}
+		const_iterator find(const Key &key) const
+		{
+			const_iterator it;
+			it.nd = lowerBound(key);
+			if (it.nd != NULL && comp(key, it.nd->value.first))
+				it.nd = NULL;
+			return it;
+		}
+		/**
+		* the first element whose key is not less than key, end() if none.
+		*/
+		const_iterator lower_bound(const Key &key) const
+		{
+			const_iterator it;
+			it.nd = lowerBound(key);
+			return it;
+		}
+		/**
+		* the first element whose key is greater than key, end() if none.
+		*/
+		const_iterator upper_bound(const Key &key) const
+		{
+			const_iterator it;
+			it.nd = lowerBound(key);
+			if (it.nd != NULL && !comp(key, it.nd->value.first))
+				++it;
+			return it;
+		}
+		const_iterator begin() const
+		{
+			const_iterator it;
+			it.nd = live(ptr(head[0].load(std::memory_order_acquire)));
+			return it;
+		}
+		const_iterator cbegin() const
+		{
+			return begin();
+		}
+		const_iterator end() const
+		{
+			return const_iterator();
+		}
+		const_iterator cend() const
+		{
+			return const_iterator();
+		}
+		/**
+		* the number of elements, exact only while no one is changing the map.
+		*/
+		size_t size() const
+		{
+			long n = _size.load(std::memory_order_relaxed);
+			return n < 0 ? 0 : static_cast<size_t>(n);
+		}
+		bool empty() const
+		{
+			return begin() == end();
+		}
+		/**
+		* insert value unless its key is there; true if it was inserted.
+		*/
+		bool insert(const value_type &value)
+		{
+			return emplace(value.first, value);
+		}
+		bool insert(value_type &&value)
+		{
+			return emplace(value.first, std::move(value));
+		}
+		/**
+		* erase the element with key, if any.
+		* returns the number of elements removed (0 or 1).
+		*/
+		size_t erase(const Key &key)
+		{
+			epoch::guard g;
+			Node *preds[MAX_LEVEL], *succs[MAX_LEVEL];
+			if (!search(key, preds, succs))
+				return 0;
+			Node *victim = succs[0];
+			for (int i = victim->height - 1; i > 0; i--)
+			{
+				uintptr_t link = victim->next[i].load(std::memory_order_acquire);
+				while (!marked(link) && !victim->next[i].compare_exchange_weak(link, link | 1, std::memory_order_acq_rel))
+					;
+			}
+			uintptr_t link = victim->next[0].load(std::memory_order_acquire);
+			for (;;)
+			{
+				if (marked(link))
+					return 0;
+				if (victim->next[0].compare_exchange_weak(link, link | 1, std::memory_order_acq_rel))
+					break;
+			}
+			_size.fetch_sub(1, std::memory_order_relaxed);
+			// unlink it from every level
+			search(key, preds, succs);
+			release(victim);
+			return 1;
+		}
+		/**
+		* erase everything; safe alongside other threads, but what they insert
+		*   meanwhile may survive it.
+		*/
+		void clear()
+		{
+			for (;;)
+			{
+				const_iterator it = begin();
+				if (it == end())
+					return;
+				erase(it->first);
+			}
+		}
+	private:
+		std::atomic<uintptr_t> & link(Node *pred, int level) const
+		{
+			return pred == NULL ? head[level] : pred->next[level];
+		}
+		// the first node from p on that is not erased
+		static Node * live(Node *p)
+		{
+			while (p != NULL && marked(p->next[0].load(std::memory_order_acquire)))
+				p = ptr(p->next[0].load(std::memory_order_acquire));
+			return p;
+		}
+		/**
+		* a read-only descent to the first element not less than key.
+		* erased nodes are stepped over, not unlinked.
+		*/
+		Node * lowerBound(const Key &key) const
+		{
+			Node *pred = NULL;
+			Node *curr = NULL;
+			for (int i = MAX_LEVEL - 1; i >= 0; i--)
+			{
+				curr = ptr(link(pred, i).load(std::memory_order_acquire));
+				while (curr != NULL)
+				{
+					uintptr_t succ = curr->next[i].load(std::memory_order_acquire);
+					if (marked(succ))
+						curr = ptr(succ);
+					else if (comp(curr->value.first, key))
+					{
+						pred = curr;
+						curr = ptr(succ);
+					}
+					else
+						break;
+				}
+			}
+			return live(curr);
+		}
+		/**
+		* the neighbours of key on every level: preds[i] is the last node
+		*   before it (NULL for the head) and succs[i] the first not less.
+		* marked nodes on the way are unlinked; when that fails because the
+		*   predecessor changed, it starts over.
+		* returns whether succs[0] holds key.
+		*/
+		bool search(const Key &key, Node **preds, Node **succs)
+		{
+		retry:
+			Node *pred = NULL;
+			for (int i = MAX_LEVEL - 1; i >= 0; i--)
+			{
+				Node *curr = ptr(link(pred, i).load(std::memory_order_acquire));
+				while (curr != NULL)
+				{
+					uintptr_t succ = curr->next[i].load(std::memory_order_acquire);
+					if (marked(succ))
+					{
+						uintptr_t expected = raw(curr);
+						if (!link(pred, i).compare_exchange_strong(expected, succ & ~static_cast<uintptr_t>(1), std::memory_order_acq_rel))
+							goto retry;
+						curr = ptr(succ);
+					}
+					else if (comp(curr->value.first, key))
+					{
+						pred = curr;
+						curr = ptr(succ);
+					}
+					else
+						break;
+				}
+				preds[i] = pred;
+				succs[i] = curr;
+			}
+			return succs[0] != NULL && !comp(key, succs[0]->value.first);
+		}
+		/**
+		* link a new node bottom-up. level 0 decides whether it is in the map;
+		*   the upper levels are only shortcuts, and linking them stops as soon
+		*   as the node turns out to be erased.
+		*/
+		template<class... Args>
+		bool emplace(const Key &key, Args&&... args)
+		{
+			epoch::guard g;
+			Node *preds[MAX_LEVEL], *succs[MAX_LEVEL];
+			Node *node = NULL;
+			int height = randomHeight();
+			for (;;)
+			{
+				if (search(key, preds, succs))
+				{
+					if (node != NULL)
+						drop(node);
+					return false;
+				}
+				if (node == NULL)
+					node = newNode(height, std::forward<Args>(args)...);
+				for (int i = 0; i < height; i++)
+					node->next[i].store(raw(succs[i]), std::memory_order_relaxed);
+				uintptr_t expected = raw(succs[0]);
+				if (link(preds[0], 0).compare_exchange_strong(expected, raw(node), std::memory_order_acq_rel))
+					break;
+			}
+			_size.fetch_add(1, std::memory_order_relaxed);
+			for (int i = 1; i < height; i++)
+			{
+				for (;;)
+				{
+					uintptr_t old = node->next[i].load(std::memory_order_acquire);
+					if (marked(old))
+						goto linked;
+					if (old != raw(succs[i]) && !node->next[i].compare_exchange_strong(old, raw(succs[i]), std::memory_order_acq_rel))
+						goto linked;
+					uintptr_t expected = raw(succs[i]);
+					if (link(preds[i], i).compare_exchange_strong(expected, raw(node), std::memory_order_acq_rel))
+						break;
+					search(key, preds, succs);
+					if (succs[0] != node)
+						goto linked;
+				}
+			}
+		linked:
+			// erased while its levels went in: one of them may be linked after the eraser looked
+			if (marked(node->next[0].load(std::memory_order_acquire)))
+				search(key, preds, succs);
+			release(node);
+			return true;
+		}
+		// 1 + the number of heads in a row, one chance in four each
+		static int randomHeight()
+		{
+			static thread_local uint32_t state = 0;
+			if (state == 0)
+				state = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(&state) >> 4) | 1;
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			int height = 1;
+			for (uint32_t r = state; height < MAX_LEVEL && (r & 3) == 0; r >>= 2)
+				height++;
+			return height;
+		}
+		template<class... Args>
+		static Node * newNode(int height, Args&&... args)
+		{
+			void *mem = ::operator new(sizeof(Node) + (height - 1) * sizeof(std::atomic<uintptr_t>));
+			Node *p;
+			try {
+				p = new (mem) Node(height, std::forward<Args>(args)...);
+			}
+			catch (...) {
+				::operator delete(mem);
+				throw;
+			}
+			for (int i = 1; i < height; i++)
+				new (&p->next[i]) std::atomic<uintptr_t>(0);
+			return p;
+		}
+		static void drop(void *mem)
+		{
+			Node *p = static_cast<Node*>(mem);
+			p->~Node();
+			::operator delete(mem);
+		}
+		void release(Node *p)
+		{
+			if (p->links.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				epoch::retire(p, &drop);
+		}
+	private:
+		mutable std::atomic<uintptr_t> head[MAX_LEVEL];
+		std::atomic<long> _size;
+		Compare comp;
+	};
+
+}
+
+#endif
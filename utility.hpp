@@ -1,10 +1,18 @@
 #ifndef SJTU_UTILITY_HPP
 #define SJTU_UTILITY_HPP
 
+#include <cstddef>
+#include <tuple>
 #include <utility>
 
 namespace sjtu {
 
+template<size_t... I> struct index_list {};
+template<size_t N, size_t... I>
+struct make_index_list : make_index_list<N - 1, N - 1, I...> {};
+template<size_t... I>
+struct make_index_list<0, I...> { typedef index_list<I...> type; };
+
 template<class T1, class T2>
 class pair {
 public:
@@ -13,13 +21,22 @@ public:
 	constexpr pair() : first(), second() {}
 	pair(const pair &other) = default;
 	pair(pair &&other) = default;
+	pair & operator=(const pair &other) = default;
+	pair & operator=(pair &&other) = default;
 	pair(const T1 &x, const T2 &y) : first(x), second(y) {}
 	template<class U1, class U2>
-	pair(U1 &&x, U2 &&y) : first(x), second(y) {}
+	pair(U1 &&x, U2 &&y) : first(std::forward<U1>(x)), second(std::forward<U2>(y)) {}
 	template<class U1, class U2>
 	pair(const pair<U1, U2> &other) : first(other.first), second(other.second) {}
 	template<class U1, class U2>
-	pair(pair<U1, U2> &&other) : first(other.first), second(other.second) {}
+	pair(pair<U1, U2> &&other) : first(std::move(other.first)), second(std::move(other.second)) {}
+	template<class... A1, class... A2>
+	pair(std::piecewise_construct_t, std::tuple<A1...> a, std::tuple<A2...> b)
+		: pair(a, b, typename make_index_list<sizeof...(A1)>::type(), typename make_index_list<sizeof...(A2)>::type()) {}
+private:
+	template<class... A1, class... A2, size_t... I1, size_t... I2>
+	pair(std::tuple<A1...> &a, std::tuple<A2...> &b, index_list<I1...>, index_list<I2...>)
+		: first(std::forward<A1>(std::get<I1>(a))...), second(std::forward<A2>(std::get<I2>(b))...) {}
 };
 
 }
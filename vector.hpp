@@ -5,6 +5,7 @@
 #include <climits>
 #include <cstddef>
 #include <memory>
+#include <utility>
 
 using namespace std;
 
@@ -219,6 +220,13 @@ public:
 			al.construct(_data+i, other[i]);
 		}
 	}
+	// takes the storage of other, which is left empty
+	vector(vector &&other) {
+		_size = 0;
+		_capacity = DEFAULT_CAPACITY;
+		_data = al.allocate(_capacity);
+		*this = std::move(other);
+	}
 	/**
 	 * TODO Destructor
 	 */
@@ -234,18 +242,28 @@ public:
 	 * TODO Assignment operator
 	 */
 	vector &operator=(const vector &other) {
-		_size = other.size();
-		_capacity = other.capacity();
-		if (_data == NULL)
+		if (this == &other)
+			return *this;
+		destroy();
+		if (_capacity < other.size())
 		{
+			al.deallocate(_data, _capacity);
+			_capacity = other.capacity();
 			_data = al.allocate(_capacity);
 		}
+		_size = other.size();
 		for (int i = 0; i < _size; i++)
 		{
 			al.construct(_data+i, other[i]);
 		}
 		return *this;
 	}
+	vector &operator=(vector &&other) {
+		std::swap(_size, other._size);
+		std::swap(_capacity, other._capacity);
+		std::swap(_data, other._data);
+		return *this;
+	}
 	/**
 	 * assigns specified element with bounds checking
 	 * throw index_out_of_bound if pos is not in [0, size)
@@ -436,18 +454,13 @@ public:
 	 */
 	iterator erase(iterator pos) {
 		size_t dpos = pos - begin();
-		iterator it;
-		for (int i = dpos; i < _size - 1; i++)
+		for (size_t i = dpos; i + 1 < _size; i++)
 		{
 			_data[i] = _data[i + 1];
 		}
-		if (dpos == _size - 1)
-			iterator it = end();
-		else
-			iterator it(_data + dpos, dpos);
 		_size--;
 		al.destroy(_data + _size);
-		return it;
+		return iterator(_data + dpos, dpos);
 	}
 	/**
 	 * removes the element with index ind.
@@ -455,21 +468,16 @@ public:
 	 * throw index_out_of_bound if ind >= size
 	 */
 	iterator erase(const size_t &ind) {
-		iterator it;
 		if (ind >= _size)
 			throw index_out_of_bound();
 		else {
-			for (int i = ind; i < _size - 1; i++)
+			for (size_t i = ind; i + 1 < _size; i++)
 			{
 				_data[i] = _data[i + 1];
 			}
-			if (ind == _size)
-				iterator it = end();
-			else
-				iterator it(_data + ind, ind);
 			_size--;
 			al.destroy(_data + _size);
-			return it;
+			return iterator(_data + ind, ind);
 		}
 	}
 	/**
@@ -481,6 +489,12 @@ public:
 		al.construct(_data + _size, value);
 		_size++;
 	}
+	void push_back(T &&value) {
+		if (_size >= _capacity)
+			reallocate();
+		al.construct(_data + _size, std::move(value));
+		_size++;
+	}
 	/**
 	 * remove the last element from the end.
 	 * throw container_is_empty if size() == 0
@@ -520,8 +534,7 @@ private:
 		{
 			al.construct(newData + i, _data[i]);
 		}
-		for (T *p = _data + _size; p != _data; p--)
-			al.destroy(--p);
+		destroy();
 		if (_data != NULL)
 			al.deallocate(_data, _capacity);
 		_data = newData;